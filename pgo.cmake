@@ -0,0 +1,103 @@
+# Profile-guided optimization build of Nuspell.
+#
+# Usage: cmake [-DPGO_BINARY_DIR=dir] [-DPGO_ROUNDS=n] -P pgo.cmake
+#
+# Builds two trees under PGO_BINARY_DIR (default ./pgo-build):
+#   baseline  - plain Release build
+#   optimized - first built with NUSPELL_PGO=GENERATE, instrumented, then
+#               rebuilt with NUSPELL_PGO=USE, i.e. with profile and LTO.
+#               GCC names the profile files by the paths of the object
+#               files, so both phases must use the same tree.
+# The instrumented build runs the workload tests/pgo_workload.cxx over the
+# dictionaries in tests/v1cmdline to collect the profile. At the end the
+# workload is timed with the baseline and the optimized build and the
+# speedup is reported. Extra configure arguments, e.g. the compiler, can be
+# given in PGO_CMAKE_ARGS as a list.
+
+cmake_minimum_required(VERSION 3.13)
+
+set(src_dir "${CMAKE_CURRENT_LIST_DIR}")
+if (NOT PGO_BINARY_DIR)
+    set(PGO_BINARY_DIR "${CMAKE_CURRENT_BINARY_DIR}/pgo-build")
+endif()
+get_filename_component(PGO_BINARY_DIR "${PGO_BINARY_DIR}" ABSOLUTE)
+if (NOT PGO_ROUNDS)
+    set(PGO_ROUNDS 3)
+endif()
+set(profile_dir "${PGO_BINARY_DIR}/profile")
+
+file(GLOB affs "${src_dir}/tests/v1cmdline/*.aff")
+set(dicts "")
+foreach (aff ${affs})
+    string(REGEX REPLACE "\\.aff$" "" dict "${aff}")
+    list(APPEND dicts "${dict}")
+endforeach()
+if (NOT dicts)
+    message(FATAL_ERROR "No training dictionaries in tests/v1cmdline")
+endif()
+
+function(run)
+    execute_process(COMMAND ${ARGN} RESULT_VARIABLE err)
+    if (err)
+        string(REPLACE ";" " " cmd "${ARGN}")
+        message(FATAL_ERROR "Command failed: ${cmd}")
+    endif()
+endfunction()
+
+function(build_tree name)
+    set(dir "${PGO_BINARY_DIR}/${name}")
+    message(STATUS "Building ${name} tree ${ARGN}")
+    run(${CMAKE_COMMAND} -S "${src_dir}" -B "${dir}"
+        -DCMAKE_BUILD_TYPE=Release -DNUSPELL_PGO_DIR=${profile_dir}
+        ${PGO_CMAKE_ARGS} ${ARGN})
+    run(${CMAKE_COMMAND} --build "${dir}" --target pgo_workload)
+endfunction()
+
+# returns the workload time in milliseconds
+function(run_workload name rounds out_var)
+    execute_process(
+        COMMAND "${PGO_BINARY_DIR}/${name}/tests/pgo_workload"
+            -r ${rounds} ${dicts}
+        RESULT_VARIABLE err
+        OUTPUT_VARIABLE out)
+    if (err)
+        message(FATAL_ERROR "The workload of the ${name} tree failed")
+    endif()
+    string(REGEX MATCH "workload time: ([0-9]+)" _ "${out}")
+    set(${out_var} "${CMAKE_MATCH_1}" PARENT_SCOPE)
+endfunction()
+
+file(REMOVE_RECURSE "${profile_dir}")
+build_tree(baseline -DNUSPELL_PGO=)
+build_tree(optimized -DNUSPELL_PGO=GENERATE)
+
+message(STATUS "Training")
+run_workload(optimized 1 _)
+file(GLOB_RECURSE raw_profiles "${profile_dir}/*.profraw")
+if (raw_profiles)
+    # Clang writes raw profiles that have to be merged
+    find_program(LLVM_PROFDATA llvm-profdata)
+    if (NOT LLVM_PROFDATA)
+        message(FATAL_ERROR "llvm-profdata is needed for Clang profiles")
+    endif()
+    run(${LLVM_PROFDATA} merge -o "${profile_dir}/nuspell.profdata"
+        ${raw_profiles})
+endif()
+
+build_tree(optimized -DNUSPELL_PGO=USE)
+
+message(STATUS "Measuring, ${PGO_ROUNDS} rounds")
+run_workload(baseline ${PGO_ROUNDS} base_ms)
+run_workload(optimized ${PGO_ROUNDS} opt_ms)
+if (opt_ms GREATER 0)
+    math(EXPR speedup_x100 "${base_ms} * 100 / ${opt_ms}")
+    math(EXPR int_part "${speedup_x100} / 100")
+    math(EXPR frac_part "${speedup_x100} % 100")
+    if (frac_part LESS 10)
+        set(frac_part "0${frac_part}")
+    endif()
+    message(STATUS "Baseline:  ${base_ms} ms")
+    message(STATUS "Optimized: ${opt_ms} ms")
+    message(STATUS "Speedup:   ${int_part}.${frac_part}x")
+endif()
+message(STATUS "The optimized library is in ${PGO_BINARY_DIR}/optimized/src/nuspell")
@@ -20,9 +20,14 @@
 #include "utils.hxx"
 
 #include <iostream>
+#include <limits>
+#include <map>
+#include <mutex>
 #include <sstream>
 #include <unordered_map>
 
+#include <unicode/utf8.h>
+
 /*
  * Aff_Data class and the method parse() should be structured in the following
  * way. The data members of the class should be data structures that are
@@ -111,6 +116,33 @@ enum class Parsing_Error_Code {
 	COMPOUND_RULE_INVALID_FORMAT
 };
 
+/**
+ * @brief Scans a decimal number without sign and leading whitespace.
+ *
+ * Unlike strtoul() it does not depend on the locale and errno. Numbers that
+ * do not fit are saturated.
+ *
+ * @param p the first char
+ * @param last the end of the string
+ * @param out the number
+ * @return pointer past the last digit, @p p if there are no digits
+ */
+auto scan_decimal(const char* p, const char* last, size_t& out) -> const char*
+{
+	auto constexpr max = numeric_limits<size_t>::max();
+	out = 0;
+	for (; p != last; ++p) {
+		auto d = size_t(static_cast<unsigned char>(*p) - '0');
+		if (d > 9)
+			break;
+		if (out > (max - d) / 10)
+			out = max;
+		else
+			out = out * 10 + d;
+	}
+	return p;
+}
+
 auto decode_flags(const string& s, Flag_Type t, const Encoding& enc,
                   u16string& out) -> Parsing_Error_Code
 {
@@ -140,33 +172,27 @@ auto decode_flags(const string& s, Flag_Type t, const Encoding& enc,
 		if (s.size() % 2 == 1)
 			return Err::UNPAIRED_LONG_FLAG;
 
-		auto i = s.begin();
-		auto e = s.end();
-		for (; i != e; i += 2) {
-			auto c1 = *i;
-			auto c2 = *(i + 1);
-			out.push_back((c1 << 8) | c2);
+		out.resize(s.size() / 2);
+		for (size_t i = 0; i != out.size(); ++i) {
+			auto c1 = s[2 * i];
+			auto c2 = s[2 * i + 1];
+			out[i] = (c1 << 8) | c2;
 		}
 		break;
 	}
 	case Ft::NUMBER: {
-		auto p = s.c_str();
-		char* p2 = nullptr;
-		errno = 0;
+		auto p = s.data();
+		auto last = p + s.size();
 		for (;;) {
-			auto flag = strtoul(p, &p2, 10);
+			auto flag = size_t();
+			auto p2 = scan_decimal(p, last, flag);
 			if (p2 == p)
 				return Err::INVALID_NUMERIC_FLAG;
-			if (flag == numeric_limits<decltype(flag)>::max() &&
-			    errno == ERANGE) {
-				errno = 0;
-				return Err::FLAG_ABOVE_65535;
-			}
 			if (flag > 0xFFFF)
 				return Err::FLAG_ABOVE_65535;
 			out.push_back(flag);
 
-			if (p2 == &s[s.size()] || *p2 != ',')
+			if (p2 == last || *p2 != ',')
 				break;
 
 			p = p2 + 1;
@@ -177,13 +203,24 @@ auto decode_flags(const string& s, Flag_Type t, const Encoding& enc,
 		// if (!enc.is_utf8())
 		//	return Err::FLAGS_ARE_UTF8_BUT_FILE_NOT;
 
-		auto ok = utf8_to_16(s, out);
-		if (!ok) {
-			out.clear();
-			return Err::INVALID_UTF8;
+		// Decoded directly into UTF-16 code units, flags outside of
+		// the BMP are rejected without a second pass.
+		out.resize(s.size());
+		auto o = size_t();
+		auto above_bmp = false;
+		auto p = reinterpret_cast<const uint8_t*>(s.data());
+		for (int32_t i = 0, n = s.size(); i != n;) {
+			auto cp = UChar32();
+			U8_NEXT(p, i, n, cp);
+			if (cp < 0) {
+				out.clear();
+				return Err::INVALID_UTF8;
+			}
+			above_bmp |= cp > 0xFFFF;
+			out[o++] = cp;
 		}
-
-		if (!is_all_bmp(out)) {
+		out.resize(o);
+		if (above_bmp) {
 			out.clear();
 			return Err::FLAG_ABOVE_65535;
 		}
@@ -193,6 +230,20 @@ auto decode_flags(const string& s, Flag_Type t, const Encoding& enc,
 	return warn;
 }
 
+auto decode_flag_alias(const string& s, size_t num_aliases, size_t& idx)
+    -> Parsing_Error_Code
+{
+	auto i = size_t();
+	auto last = s.data() + s.size();
+	if (scan_decimal(s.data(), last, i) == s.data())
+		return Parsing_Error_Code::INVALID_NUMERIC_ALIAS;
+	if (0 < i && i <= num_aliases) {
+		idx = i - 1;
+		return {};
+	}
+	return Parsing_Error_Code::INVALID_NUMERIC_ALIAS;
+}
+
 auto decode_flags_possible_alias(const string& s, Flag_Type t,
                                  const Encoding& enc,
                                  const vector<Flag_Set>& flag_aliases,
@@ -201,21 +252,12 @@ auto decode_flags_possible_alias(const string& s, Flag_Type t,
 	if (flag_aliases.empty())
 		return decode_flags(s, t, enc, out);
 
-	char* p;
-	errno = 0;
 	out.clear();
-	auto i = strtoul(s.c_str(), &p, 10);
-	if (p == s.c_str())
-		return Parsing_Error_Code::INVALID_NUMERIC_ALIAS;
-
-	if (i == numeric_limits<decltype(i)>::max() && errno == ERANGE)
-		return Parsing_Error_Code::INVALID_NUMERIC_ALIAS;
-
-	if (0 < i && i <= flag_aliases.size()) {
-		out = flag_aliases[i - 1];
-		return {};
-	}
-	return Parsing_Error_Code::INVALID_NUMERIC_ALIAS;
+	auto i = size_t();
+	auto err = decode_flag_alias(s, flag_aliases.size(), i);
+	if (err == Parsing_Error_Code::NO_ERROR)
+		out = flag_aliases[i];
+	return err;
 }
 
 auto report_parsing_error(Parsing_Error_Code err, size_t line_num)
@@ -618,7 +660,6 @@ class Aff_Line_Stream : public std::istringstream {
 		return parse_compound_rule(rule.rule);
 	}
 
-#if 0
 	auto& parse_morhological_fields(vector<string>& out)
 	{
 		auto& in = *this;
@@ -627,8 +668,10 @@ class Aff_Line_Stream : public std::istringstream {
 		out.clear();
 		auto old_mask = in.exceptions();
 		in.exceptions(in.goodbit); // disable exceptions
+		auto wide_buf = wstring();
 		while (in >> str_buf) {
-			out.push_back(str_buf);
+			cvt.to_wide(str_buf, wide_buf);
+			wide_to_utf8(wide_buf, out.emplace_back());
 		}
 		if (in.fail() && !in.bad())
 			reset_failbit_istream(in);
@@ -640,7 +683,6 @@ class Aff_Line_Stream : public std::istringstream {
 	{
 		return parse_morhological_fields(out);
 	}
-#endif
 };
 auto Aff_Line_Stream::dummy_func() -> void {}
 
@@ -720,9 +762,45 @@ auto parse_vector_of_T(Aff_Line_Stream& in, const string& command,
 	}
 }
 
+/**
+ * @brief Stores morphological fields in the morphological table.
+ *
+ * A single numerical field is a reference to the AM aliases, if there are
+ * any.
+ *
+ * @param fields the fields, already converted to UTF-8.
+ * @return the index of the fields in the table.
+ */
+auto intern_morph_fields(const vector<string>& fields,
+                         const vector<vector<string>>& aliases,
+                         Morph_Table& table) -> Morph_Table::Fields_Id
+{
+	auto f = &fields;
+	if (fields.size() == 1 && !aliases.empty()) {
+		auto& a = fields[0];
+		auto is_digit = [](char c) { return c >= '0' && c <= '9'; };
+		if (all_of(begin(a), end(a), is_digit)) {
+			auto idx = strtoul(a.c_str(), nullptr, 10);
+			if (idx == 0 || idx > aliases.size())
+				return Morph_Table::NO_FIELDS;
+			f = &aliases[idx - 1];
+		}
+	}
+	if (f->empty())
+		return Morph_Table::NO_FIELDS;
+	auto joined = string();
+	for (auto& x : *f) {
+		if (!joined.empty())
+			joined += ' ';
+		joined += x;
+	}
+	return table.intern(joined);
+}
+
 template <class AffixT>
 auto parse_affix(Aff_Line_Stream& in, string& command, vector<AffixT>& vec,
-                 unordered_map<string, pair<bool, size_t>>& cmd_affix) -> void
+                 unordered_map<string, pair<bool, size_t>>& cmd_affix,
+                 Aff_Data& aff) -> void
 {
 	char16_t f;
 	in >> f;
@@ -772,7 +850,10 @@ auto parse_affix(Aff_Line_Stream& in, string& command, vector<AffixT>& vec,
 		}
 		in.exceptions(old_mask);
 
-		// in >> elem.morphological_fields;
+		auto morph = vector<string>();
+		in >> morph; // optional
+		elem.morph_fields = intern_morph_fields(
+		    morph, aff.morph_aliases, aff.morph_table);
 	}
 	else {
 		cerr << "Nuspell warning: extra entries of "
@@ -782,9 +863,111 @@ auto parse_affix(Aff_Line_Stream& in, string& command, vector<AffixT>& vec,
 
 } // namespace
 
+namespace {
+/**
+ * @brief Process-wide registry of loaded Aff_Rules.
+ *
+ * Entries are found by the hash of the .aff file content and are shared
+ * only if the whole content is equal. Entries do not keep the
+ * rules alive.
+ */
+struct Aff_Rules_Registry {
+	struct Entry {
+		string content;
+		weak_ptr<const Aff_Rules> rules;
+	};
+	mutex mtx;
+	multimap<uint64_t, Entry> entries;
+
+	auto find(uint64_t hash, const string& content)
+	    -> shared_ptr<const Aff_Rules>
+	{
+		auto lock = lock_guard<mutex>(mtx);
+		return find_locked(hash, content);
+	}
+	auto insert(uint64_t hash, string&& content,
+	            shared_ptr<const Aff_Rules> rules)
+	    -> shared_ptr<const Aff_Rules>
+	{
+		auto lock = lock_guard<mutex>(mtx);
+		for (auto it = begin(entries); it != end(entries);) {
+			if (it->second.rules.expired())
+				it = entries.erase(it);
+			else
+				++it;
+		}
+		if (auto existing = find_locked(hash, content))
+			return existing; // another thread was faster
+		entries.emplace(hash, Entry{std::move(content), rules});
+		return rules;
+	}
+	/**
+	 * @brief Removes the entry of the rules if @p rules is the only owner.
+	 *
+	 * New owners of registered rules are created only under the mutex, so
+	 * the check and the removal can not be interleaved with a find().
+	 *
+	 * @return true if @p rules is the only owner and stays so.
+	 */
+	auto erase_if_unique(const shared_ptr<const Aff_Rules>& rules) -> bool
+	{
+		auto lock = lock_guard<mutex>(mtx);
+		if (rules.use_count() != 1)
+			return false;
+		for (auto it = begin(entries); it != end(entries); ++it) {
+			if (it->second.rules.lock() == rules) {
+				entries.erase(it);
+				break;
+			}
+		}
+		return true;
+	}
+
+      private:
+	auto find_locked(uint64_t hash, const string& content)
+	    -> shared_ptr<const Aff_Rules>
+	{
+		auto r = entries.equal_range(hash);
+		for (auto it = r.first; it != r.second; ++it) {
+			auto& e = it->second;
+			if (e.content != content)
+				continue;
+			if (auto rules = e.rules.lock())
+				return rules;
+		}
+		return nullptr;
+	}
+};
+
+auto get_aff_rules_registry() -> Aff_Rules_Registry&
+{
+	static auto registry = Aff_Rules_Registry();
+	return registry;
+}
+} // namespace
+
+/**
+ * @brief Gets the rules for modification, copying them if they are shared.
+ *
+ * Rules that are modified in place are removed from the registry first, so
+ * later loads of the same .aff file do not get the modified rules. It is
+ * safe to call this while other threads load dictionaries, but like any
+ * non-const function, not while another thread uses this object.
+ */
+auto Aff_Data::edit_rules() -> Aff_Rules&
+{
+	if (!get_aff_rules_registry().erase_if_unique(rules))
+		rules = make_shared<Aff_Rules>(*rules);
+	// we are the only owner and the object was not created as const
+	return const_cast<Aff_Rules&>(*rules);
+}
+
 /**
  * Parses an input stream offering affix information.
  *
+ * The affix-side data, see Aff_Rules, is shared with previously loaded
+ * dictionaries that are still alive and whose .aff content is identical.
+ *
  * @param in input stream to parse from.
  * @return true on success.
  */
@@ -796,8 +979,7 @@ auto Aff_Data::parse_aff(istream& in) -> bool
 	auto break_exists = false;
 	auto input_conversion = vector<pair<wstring, wstring>>();
 	auto output_conversion = vector<pair<wstring, wstring>>();
-	// auto morphological_aliases = vector<vector<string>>();
-	auto rules = vector<u16string>();
+	auto compound_rule_strs = vector<u16string>();
 	auto replacements = vector<pair<wstring, wstring>>();
 	auto map_related_chars = vector<wstring>();
 	auto phonetic_replacements = vector<pair<wstring, wstring>>();
@@ -880,8 +1062,11 @@ auto Aff_Data::parse_aff(istream& in) -> bool
 	ss.imbue(locale::classic());
 	ss.set_aff_data(*this);
 	strip_utf8_bom(in);
+	auto content = string();
 	while (getline(in, line)) {
 		line_num++;
+		content += line;
+		content += '\n';
 		ss.str(line);
 		ss.clear();
 		ss.err = {};
@@ -892,10 +1077,10 @@ auto Aff_Data::parse_aff(istream& in) -> bool
 		ss >> command;
 		to_upper_ascii(command);
 		if (command == "SFX") {
-			parse_affix(ss, command, suffixes, cmd_affix);
+			parse_affix(ss, command, suffixes, cmd_affix, *this);
 		}
 		else if (command == "PFX") {
-			parse_affix(ss, command, prefixes, cmd_affix);
+			parse_affix(ss, command, prefixes, cmd_affix, *this);
 		}
 		else if (command_wstrings.count(command)) {
 			auto& str = *command_wstrings[command];
@@ -952,8 +1137,8 @@ auto Aff_Data::parse_aff(istream& in) -> bool
 			                  flag_aliases);
 		}
 		else if (command == "AM") {
-			// parse_vector_of_T(ss, command, cmd_with_vec_cnt,
-			//                  morphological_aliases);
+			parse_vector_of_T(ss, command, cmd_with_vec_cnt,
+			                  morph_aliases);
 		}
 		else if (command == "BREAK") {
 			parse_vector_of_T(ss, command, cmd_with_vec_cnt,
@@ -965,8 +1150,8 @@ auto Aff_Data::parse_aff(istream& in) -> bool
 			                  compound_patterns);
 		}
 		else if (command == "COMPOUNDRULE") {
-			parse_vector_of_T(ss, command, cmd_with_vec_cnt, rules,
-			                  wrap_compound_rule);
+			parse_vector_of_T(ss, command, cmd_with_vec_cnt,
+			                  compound_rule_strs, wrap_compound_rule);
 		}
 		else if (command == "COMPOUNDSYLLABLE") {
 			ss >> compound_syllable_max;
@@ -993,27 +1178,37 @@ auto Aff_Data::parse_aff(istream& in) -> bool
 	if (!break_exists) {
 		break_patterns = {L"-", L"^-", L"-$"};
 	}
-	for (auto& r : replacements) {
-		auto& s = r.second;
-		replace_char(s, L'_', L' ');
-	}
 
 	// now fill data structures from temporary data
-	compound_rules = std::move(rules);
-	similarities.assign(begin(map_related_chars), end(map_related_chars));
+	compound_rules = std::move(compound_rule_strs);
 	break_table = std::move(break_patterns);
 	input_substr_replacer = std::move(input_conversion);
 	output_substr_replacer = std::move(output_conversion);
-	this->replacements = std::move(replacements);
-	phonetic_table = std::move(phonetic_replacements);
-	for (auto& x : prefixes) {
-		erase_chars(x.appending, ignored_chars);
-	}
-	for (auto& x : suffixes) {
-		erase_chars(x.appending, ignored_chars);
+
+	auto& registry = get_aff_rules_registry();
+	content_hash = hash_bytes(content, 0);
+	rules = registry.find(content_hash, content);
+	if (!rules) {
+		for (auto& r : replacements) {
+			auto& s = r.second;
+			replace_char(s, L'_', L' ');
+		}
+		for (auto& x : prefixes) {
+			erase_chars(x.appending, ignored_chars);
+		}
+		for (auto& x : suffixes) {
+			erase_chars(x.appending, ignored_chars);
+		}
+		auto new_rules = make_shared<Aff_Rules>();
+		new_rules->similarities.assign(begin(map_related_chars),
+		                               end(map_related_chars));
+		new_rules->replacements = std::move(replacements);
+		new_rules->phonetic_table = std::move(phonetic_replacements);
+		new_rules->prefixes = std::move(prefixes);
+		new_rules->suffixes = std::move(suffixes);
+		rules = registry.insert(content_hash, std::move(content),
+		                        std::move(new_rules));
 	}
-	this->prefixes = std::move(prefixes);
-	this->suffixes = std::move(suffixes);
 
 	cerr.flush();
 	return in.eof() && !error_happened; // true for success
@@ -1047,6 +1242,16 @@ auto dic_find_end_of_word_heuristics(const string& line)
 	return line.npos;
 }
 
+auto split_on_whitespace(const string& s, vector<string>& out) -> void
+{
+	auto ws = " \t\r";
+	for (auto i = s.find_first_not_of(ws); i != s.npos;) {
+		auto j = s.find_first_of(ws, i);
+		out.emplace_back(s, i, j - i);
+		i = s.find_first_not_of(ws, j);
+	}
+}
+
 /**
  * Parses an input stream offering dictionary information.
  *
@@ -1061,7 +1266,11 @@ auto Aff_Data::parse_dic(istream& in) -> bool
 	string word;
 	string flags_str;
 	u16string flags;
+	const Flag_Set* alias = nullptr;
 	wstring wide_word;
+	wstring wide_morph;
+	size_t morph_pos;
+	auto morph = vector<string>();
 	auto enc_conv = Encoding_Converter(encoding.value_or_default());
 
 	// locale must be without thousands separator.
@@ -1069,21 +1278,32 @@ auto Aff_Data::parse_dic(istream& in) -> bool
 	in.imbue(locale::classic());
 	Setlocale_To_C_In_Scope setlocale_to_C;
 
+	// The words are parsed first and inserted after that. The count in
+	// the first line is only approximate and the hidden homonyms are not
+	// counted there, so inserting while parsing would rehash the table,
+	// possibly multiple times.
+	auto entries = vector<Word_List::value_type>();
+	auto entry_morphs = vector<pair<size_t, Morph_Table::Fields_Id>>();
+
 	strip_utf8_bom(in);
 	if (in >> approximate_size)
-		words.reserve(approximate_size);
+		entries.reserve(approximate_size);
 	else
 		return false;
 	getline(in, line);
+	content_hash = hash_bytes(line, content_hash ^ approximate_size);
 
 	while (getline(in, line)) {
 		line_number++;
+		content_hash = hash_bytes(line, content_hash);
 		word.clear();
 		flags_str.clear();
 		flags.clear();
+		alias = nullptr;
 
 		size_t slash_pos = 0;
 		size_t tab_pos = 0;
+		morph_pos = line.npos;
 		for (;;) {
 			slash_pos = line.find('/', slash_pos);
 			if (slash_pos == line.npos)
@@ -1103,9 +1323,19 @@ auto Aff_Data::parse_dic(istream& in) -> bool
 			auto end_flags_pos = ptr - &line[0];
 			flags_str.assign(line, slash_pos + 1,
 			                 end_flags_pos - (slash_pos + 1));
-			auto err = decode_flags_possible_alias(
-			    flags_str, flag_type, encoding, flag_aliases,
-			    flags);
+			morph_pos = end_flags_pos;
+			auto err = Parsing_Error_Code();
+			if (flag_aliases.empty()) {
+				err = decode_flags(flags_str, flag_type,
+				                   encoding, flags);
+			}
+			else {
+				auto i = size_t();
+				err = decode_flag_alias(
+				    flags_str, flag_aliases.size(), i);
+				if (err == Parsing_Error_Code::NO_ERROR)
+					alias = &flag_aliases[i];
+			}
 			report_parsing_error(err, line_number);
 			if (static_cast<int>(err) > 0)
 				continue;
@@ -1114,10 +1344,12 @@ auto Aff_Data::parse_dic(istream& in) -> bool
 			// Tab found, word until tab. No flags.
 			// After tab follow morphological fields
 			word.assign(line, 0, tab_pos);
+			morph_pos = tab_pos;
 		}
 		else {
 			auto end = dic_find_end_of_word_heuristics(line);
 			word.assign(line, 0, end);
+			morph_pos = end;
 		}
 		if (word.empty())
 			continue;
@@ -1126,10 +1358,23 @@ auto Aff_Data::parse_dic(istream& in) -> bool
 			continue;
 		erase_chars(wide_word, ignored_chars);
 		auto casing = classify_casing(wide_word);
-		auto inserted = words.emplace(wide_word, flags);
+		auto& entry = alias ? entries.emplace_back(wide_word, *alias)
+		                    : entries.emplace_back(wide_word, flags);
+		if (morph_pos < line.size()) {
+			morph.clear();
+			line.erase(0, morph_pos);
+			enc_conv.to_wide(line, wide_morph);
+			wide_to_utf8(wide_morph, line);
+			split_on_whitespace(line, morph);
+			auto id = intern_morph_fields(morph, morph_aliases,
+			                              morph_table);
+			if (id != Morph_Table::NO_FIELDS)
+				entry_morphs.emplace_back(entries.size() - 1,
+				                          id);
+		}
 		switch (casing) {
 		case Casing::ALL_CAPITAL:
-			if (flags.empty())
+			if (entry.second.empty())
 				break;
 			[[fallthrough]];
 		case Casing::PASCAL:
@@ -1139,17 +1384,115 @@ auto Aff_Data::parse_dic(istream& in) -> bool
 			// forbiddenword_flag, but by keeping the hidden
 			// homonym last in the multimap among the same-key
 			// entries.
-			if (inserted->second.contains(forbiddenword_flag))
+			if (entry.second.contains(forbiddenword_flag))
 				break;
 			auto title_word = to_title(wide_word, icu_locale);
-			flags += HIDDEN_HOMONYM_FLAG;
-			words.emplace(title_word, flags);
+			auto hidden_flags = entry.second;
+			hidden_flags.insert(HIDDEN_HOMONYM_FLAG);
+			entries.emplace_back(move(title_word),
+			                     move(hidden_flags));
 			break;
 		}
 		default:
 			break;
 		}
 	}
+
+	words.reserve(words.size() + entries.size());
+	auto m = begin(entry_morphs);
+	for (size_t i = 0; i != entries.size(); ++i) {
+		auto inserted = words.insert(move(entries[i]));
+		if (m == end(entry_morphs) || m->first != i)
+			continue;
+		auto& word_key = inserted->first;
+		auto homonyms = words.equal_range(word_key);
+		auto homonym_idx = &*inserted - &*homonyms.first;
+		morph_table.add_word_fields(word_key, homonym_idx, m->second);
+		++m;
+	}
+	morph_table.finish_loading();
 	return in.eof(); // success if we reached eof
 }
+
+/**
+ * @brief Adds fields to the table if not already present.
+ * @param fields string of fields separated by space, encoded in UTF-8.
+ * @return index of the fields.
+ */
+auto Morph_Table::intern(const std::string& fields) -> Fields_Id
+{
+	if (fields.empty())
+		return NO_FIELDS;
+	if (offsets.empty())
+		offsets.push_back(0); // the fields i are from offsets[i-1] to [i]
+	auto [it, inserted] = interned.try_emplace(fields, offsets.size());
+	if (inserted) {
+		pool += fields;
+		offsets.push_back(pool.size());
+	}
+	return it->second;
+}
+
+/**
+ * @brief Connects the fields with a word entry.
+ * @param word the word as stored in Word_List.
+ * @param homonym_idx index of the entry among the entries with same word.
+ * @param id index of the fields returned by intern().
+ */
+auto Morph_Table::add_word_fields(const std::wstring& word, size_t homonym_idx,
+                                  Fields_Id id) -> void
+{
+	auto h = std::hash<wstring>()(word);
+	entries.push_back({h, uint32_t(homonym_idx), id,
+	                   uint32_t(word_pool.size()), uint32_t(word.size())});
+	word_pool += word;
+}
+
+/**
+ * @brief Sorts the table for lookup and frees the memory used for parsing.
+ */
+auto Morph_Table::finish_loading() -> void
+{
+	sort(begin(entries), end(entries));
+	entries.shrink_to_fit();
+	word_pool.shrink_to_fit();
+	pool.shrink_to_fit();
+	offsets.shrink_to_fit();
+	interned = {};
+}
+
+auto Morph_Table::get(Fields_Id id) const -> std::string_view
+{
+	if (id == NO_FIELDS || id >= offsets.size())
+		return {};
+	auto first = offsets[id - 1];
+	auto last = offsets[id];
+	return string_view(pool).substr(first, last - first);
+}
+
+/**
+ * @brief Gets the fields of a word entry.
+ * @param words the word list that contains the entry.
+ * @param word_entry reference to an entry inside @p words.
+ * @return string of fields separated by space, or empty string.
+ */
+auto Morph_Table::get_word_fields(const Word_List& words,
+                                  Word_List::const_reference word_entry) const
+    -> std::string_view
+{
+	if (entries.empty())
+		return {};
+	auto homonyms = words.equal_range(word_entry.first);
+	auto h = std::hash<wstring>()(word_entry.first);
+	auto i = uint32_t(&word_entry - &*homonyms.first);
+	auto key = Entry{h, i, NO_FIELDS, 0, 0};
+	auto [first, last] = equal_range(begin(entries), end(entries), key);
+	auto& word = word_entry.first;
+	for (auto it = first; it != last; ++it) {
+		if (word.compare(0, word.npos, word_pool, it->word_offset,
+		                 it->word_size) == 0)
+			return get(it->fields);
+	}
+	return {};
+}
 } // namespace nuspell
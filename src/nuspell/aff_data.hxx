@@ -26,7 +26,11 @@
 
 #include "structures.hxx"
 
+#include <cstdint>
 #include <iosfwd>
+#include <memory>
+#include <tuple>
+#include <unordered_map>
 #include <unicode/locid.h>
 
 namespace nuspell {
@@ -96,19 +100,94 @@ struct Extractor_First_of_Word_Pair {
  * Flags are stored as part of the container. Maybe for the future flags should
  * be stored elsewhere (flag aliases) and this should store pointers.
  *
- * Does not store morphological data as is low priority feature and is out of
- * scope.
+ * Does not store morphological data, that is stored in Morph_Table.
  */
 using Word_List = Hash_Multiset<std::pair<std::wstring, Flag_Set>, std::wstring,
                                 Extractor_First_of_Word_Pair>;
 
+/**
+ * @brief Copies of the entries of the most used words, see Hot_Subset.
+ */
+using Hot_Word_List = Hot_Subset<Word_List::value_type, std::wstring,
+                                 Extractor_First_of_Word_Pair>;
+static_assert(std::is_same_v<Word_List::local_const_iterator,
+                             Hot_Word_List::local_const_iterator>,
+              "hot tier must give the same ranges as the word list");
+
+/**
+ * @brief Morphological fields of the dictionary words and affixes.
+ *
+ * The fields are needed only for morphological analysis, so they are kept
+ * outside of Word_List and cost nothing to words without them. Each distinct
+ * string of fields is stored only once, encoded in UTF-8, in a single buffer,
+ * and is referenced by its index. A word entry is identified by the hash of
+ * the word and by the index of the entry among its homonyms. That identity
+ * does not change when Word_List is copied or rehashed.
+ *
+ * Once loading is finished, the table consists only of flat arrays without
+ * pointers.
+ */
+class Morph_Table {
+      public:
+	using Fields_Id = std::uint32_t;
+	static constexpr Fields_Id NO_FIELDS = 0;
+
+      private:
+	struct Entry {
+		std::size_t word_hash;
+		std::uint32_t homonym_idx;
+		Fields_Id fields;
+		// the word in word_pool, compared on lookup since hashes
+		// can collide
+		std::uint32_t word_offset;
+		std::uint32_t word_size;
+		auto operator<(const Entry& e) const
+		{
+			return std::tie(word_hash, homonym_idx) <
+			       std::tie(e.word_hash, e.homonym_idx);
+		}
+	};
+	std::string pool;
+	std::vector<std::uint32_t> offsets;
+	std::vector<Entry> entries;
+	std::wstring word_pool;
+	// used only while parsing
+	std::unordered_map<std::string, Fields_Id> interned;
+
+      public:
+	auto intern(const std::string& fields) -> Fields_Id;
+	auto add_word_fields(const std::wstring& word, size_t homonym_idx,
+	                     Fields_Id id) -> void;
+	auto finish_loading() -> void;
+	auto get(Fields_Id id) const -> std::string_view;
+	auto get_word_fields(const Word_List& words,
+	                     Word_List::const_reference word_entry) const
+	    -> std::string_view;
+	auto empty() const { return pool.empty(); }
+};
+
+/**
+ * @brief Affix-side data that does not depend on the word list.
+ *
+ * Once loaded it is immutable and shared by all dictionaries whose .aff files
+ * have identical content, e.g. en_US and en_GB variants loaded side by side.
+ */
+struct Aff_Rules {
+	Prefix_Table prefixes;
+	Suffix_Table suffixes;
+	Replacement_Table<wchar_t> replacements;
+	std::vector<Similarity_Group<wchar_t>> similarities;
+	Phonetic_Table<wchar_t> phonetic_table;
+};
+
 struct Aff_Data {
 	static const auto HIDDEN_HOMONYM_FLAG = char16_t(-1);
-
 	// spell checking options
 	Word_List words;
-	Prefix_Table prefixes;
-	Suffix_Table suffixes;
+	Hot_Word_List hot_words;
+	std::shared_ptr<const Aff_Rules> rules = std::make_shared<Aff_Rules>();
+	// hash of the parsed .aff and .dic content, for caches derived from it
+	uint64_t content_hash = 0;
 
 	bool complex_prefixes;
 	bool fullstrip;
@@ -136,11 +215,8 @@ struct Aff_Data {
 	Substr_Replacer<wchar_t> output_substr_replacer;
 
 	// suggestion options
-	Replacement_Table<wchar_t> replacements;
-	std::vector<Similarity_Group<wchar_t>> similarities;
 	std::wstring keyboard_closeness;
 	std::wstring try_chars;
-	Phonetic_Table<wchar_t> phonetic_table;
 
 	char16_t nosuggest_flag;
 	char16_t substandard_flag;
@@ -169,12 +245,17 @@ struct Aff_Data {
 	std::wstring compound_syllable_vowels;
 	std::vector<Compound_Pattern<wchar_t>> compound_patterns;
 
+	// morphological analysis
+	Morph_Table morph_table;
+
 	// data members used only while parsing
 	Flag_Type flag_type;
 	Encoding encoding;
 	std::vector<Flag_Set> flag_aliases;
+	std::vector<std::vector<std::string>> morph_aliases;
 	std::string wordchars; // deprecated?
 
+	auto edit_rules() -> Aff_Rules&;
 	auto parse_aff(std::istream& in) -> bool;
 	auto parse_dic(std::istream& in) -> bool;
 	auto parse_aff_dic(std::istream& aff, std::istream& dic)
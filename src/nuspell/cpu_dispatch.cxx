@@ -0,0 +1,202 @@
+/* Copyright 2016-2019 Dimitrij Mijoski
+ *
+ * This file is part of Nuspell.
+ *
+ * Nuspell is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Nuspell is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Nuspell.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "cpu_dispatch.hxx"
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define NUSPELL_X86_DISPATCH 1
+#include <immintrin.h>
+#define TARGET(isa) __attribute__((target(isa)))
+#endif
+
+namespace nuspell {
+using namespace std;
+
+namespace {
+auto widen_ascii_generic(const char* in, size_t n, wchar_t* out) -> size_t
+{
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		uint64_t x;
+		memcpy(&x, in + i, 8);
+		if (x & 0x8080808080808080u)
+			break;
+		for (size_t j = 0; j != 8; ++j)
+			out[i + j] = in[i + j];
+	}
+	for (; i != n && (in[i] & 0x80) == 0; ++i)
+		out[i] = in[i];
+	return i;
+}
+
+#ifdef NUSPELL_X86_DISPATCH
+TARGET("sse2")
+auto widen_ascii_sse2(const char* in, size_t n, wchar_t* out) -> size_t
+{
+	size_t i = 0;
+	auto zero = _mm_setzero_si128();
+	for (; i + 16 <= n; i += 16) {
+		auto p = reinterpret_cast<const __m128i*>(in + i);
+		auto o = reinterpret_cast<__m128i*>(out + i);
+		auto v = _mm_loadu_si128(p);
+		if (_mm_movemask_epi8(v))
+			break;
+		auto lo = _mm_unpacklo_epi8(v, zero);
+		auto hi = _mm_unpackhi_epi8(v, zero);
+		if constexpr (sizeof(wchar_t) == 4) {
+			_mm_storeu_si128(o, _mm_unpacklo_epi16(lo, zero));
+			_mm_storeu_si128(o + 1, _mm_unpackhi_epi16(lo, zero));
+			_mm_storeu_si128(o + 2, _mm_unpacklo_epi16(hi, zero));
+			_mm_storeu_si128(o + 3, _mm_unpackhi_epi16(hi, zero));
+		}
+		else {
+			_mm_storeu_si128(o, lo);
+			_mm_storeu_si128(o + 1, hi);
+		}
+	}
+	return i + widen_ascii_generic(in + i, n - i, out + i);
+}
+
+TARGET("avx2")
+auto widen_ascii_avx2(const char* in, size_t n, wchar_t* out) -> size_t
+{
+	size_t i = 0;
+	for (; i + 32 <= n; i += 32) {
+		auto p = reinterpret_cast<const __m128i*>(in + i);
+		auto o = reinterpret_cast<__m256i*>(out + i);
+		auto v = _mm256_loadu_si256(
+		    reinterpret_cast<const __m256i*>(in + i));
+		if (_mm256_movemask_epi8(v))
+			break;
+		if constexpr (sizeof(wchar_t) == 4) {
+			for (auto k = 0; k != 2; ++k) {
+				auto b = _mm_loadu_si128(p + k);
+				auto b_hi = _mm_srli_si128(b, 8);
+				auto lo = _mm256_cvtepu8_epi32(b);
+				auto hi = _mm256_cvtepu8_epi32(b_hi);
+				_mm256_storeu_si256(o + 2 * k, lo);
+				_mm256_storeu_si256(o + 2 * k + 1, hi);
+			}
+		}
+		else {
+			for (auto k = 0; k != 2; ++k) {
+				auto b = _mm_loadu_si128(p + k);
+				_mm256_storeu_si256(o + k,
+				                    _mm256_cvtepu8_epi16(b));
+			}
+		}
+	}
+	// the tail is not VEX encoded, avoid the AVX-SSE transition penalty
+	_mm256_zeroupper();
+	return i + widen_ascii_sse2(in + i, n - i, out + i);
+}
+
+TARGET("avx512f,avx512bw")
+auto widen_ascii_avx512(const char* in, size_t n, wchar_t* out) -> size_t
+{
+	size_t i = 0;
+	for (; i + 64 <= n; i += 64) {
+		auto p = reinterpret_cast<const __m128i*>(in + i);
+		auto o = reinterpret_cast<__m512i*>(out + i);
+		auto v = _mm512_loadu_si512(p);
+		if (_mm512_movepi8_mask(v))
+			break;
+		if constexpr (sizeof(wchar_t) == 4) {
+			for (auto k = 0; k != 4; ++k) {
+				auto b = _mm_loadu_si128(p + k);
+				_mm512_storeu_si512(o + k,
+				                    _mm512_cvtepu8_epi32(b));
+			}
+		}
+		else {
+			auto q = reinterpret_cast<const __m256i*>(p);
+			for (auto k = 0; k != 2; ++k) {
+				auto b = _mm256_loadu_si256(q + k);
+				_mm512_storeu_si512(o + k,
+				                    _mm512_cvtepu8_epi16(b));
+			}
+		}
+	}
+	return i + widen_ascii_avx2(in + i, n - i, out + i);
+}
+#endif
+
+const auto generic_kernels = Cpu_Kernels{"generic", widen_ascii_generic};
+#ifdef NUSPELL_X86_DISPATCH
+const auto sse2_kernels = Cpu_Kernels{"sse2", widen_ascii_sse2};
+const auto avx2_kernels = Cpu_Kernels{"avx2", widen_ascii_avx2};
+const auto avx512_kernels = Cpu_Kernels{"avx512", widen_ascii_avx512};
+#endif
+
+auto select_cpu_kernels() -> const Cpu_Kernels&
+{
+	auto variants = get_cpu_kernel_variants();
+	auto requested = getenv("NUSPELL_CPU");
+	if (!requested)
+		return *variants.back();
+	for (auto v : variants)
+		if (strcmp(v->name, requested) == 0)
+			return *v;
+	cerr << "Nuspell warning: the kernel variant " << requested
+	     << " requested by NUSPELL_CPU is not supported, using "
+	     << variants.back()->name << '\n';
+	return *variants.back();
+}
+} // namespace
+
+/**
+ * @brief Gets the kernel variants that the CPU supports
+ * @return The variants, from the most portable to the fastest.
+ */
+auto get_cpu_kernel_variants() -> std::vector<const Cpu_Kernels*>
+{
+	auto ret = vector<const Cpu_Kernels*>{&generic_kernels};
+#ifdef NUSPELL_X86_DISPATCH
+	__builtin_cpu_init();
+	if (!__builtin_cpu_supports("sse2"))
+		return ret;
+	ret.push_back(&sse2_kernels);
+	if (!__builtin_cpu_supports("avx2"))
+		return ret;
+	ret.push_back(&avx2_kernels);
+	if (__builtin_cpu_supports("avx512f") &&
+	    __builtin_cpu_supports("avx512bw"))
+		ret.push_back(&avx512_kernels);
+#endif
+	return ret;
+}
+
+/**
+ * @brief Gets the kernels used by the library
+ *
+ * They are selected once, on the first call. It is the fastest variant
+ * supported by the CPU, unless the environment variable NUSPELL_CPU names
+ * another supported variant, e.g. for testing. A variant that is not
+ * supported is reported on stderr and the fastest one is used.
+ */
+auto get_cpu_kernels() -> const Cpu_Kernels&
+{
+	static const auto& kernels = select_cpu_kernels();
+	return kernels;
+}
+} // namespace nuspell
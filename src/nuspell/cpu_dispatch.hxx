@@ -0,0 +1,56 @@
+/* Copyright 2016-2019 Dimitrij Mijoski
+ *
+ * This file is part of Nuspell.
+ *
+ * Nuspell is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Nuspell is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Nuspell.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file
+ * @brief Selection of vectorized kernels by CPU features, private header.
+ */
+
+#ifndef NUSPELL_CPU_DISPATCH_HXX
+#define NUSPELL_CPU_DISPATCH_HXX
+
+#include <cstddef>
+#include <vector>
+
+namespace nuspell {
+
+/**
+ * @brief Implementations of the kernels for one instruction set
+ *
+ * The library is built for the baseline of the architecture. The variants
+ * for newer instruction sets are compiled with function target attributes
+ * and are used only if the CPU supports them.
+ */
+struct Cpu_Kernels {
+	const char* name;
+
+	/**
+	 * @brief Widens the leading ASCII characters
+	 *
+	 * Copies the chars of @p in to @p out until the first non-ASCII one.
+	 *
+	 * @return The number of copied chars.
+	 */
+	size_t (*widen_ascii)(const char* in, size_t n, wchar_t* out);
+};
+
+auto get_cpu_kernel_variants() -> std::vector<const Cpu_Kernels*>;
+auto get_cpu_kernels() -> const Cpu_Kernels&;
+
+} // namespace nuspell
+#endif // NUSPELL_CPU_DISPATCH_HXX
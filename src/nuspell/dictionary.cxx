@@ -19,12 +19,26 @@
 #include "dictionary.hxx"
 #include "utils.hxx"
 
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
 #include <fstream>
 #include <iostream>
+#include <limits>
+#include <mutex>
 #include <stdexcept>
 
 #include <unicode/uchar.h>
 
+#if !defined(_WIN32) && (defined(__unix__) || defined(__unix) ||               \
+                         (defined(__APPLE__) && defined(__MACH__)))
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 namespace nuspell {
 
 #ifdef __GNUC__
@@ -60,6 +74,89 @@ class At_Scope_Exit {
 
 #define AT_SCOPE_EXIT(...) ASE_INTERNAL2(__COUNTER__, __VA_ARGS__)
 
+inline namespace v3 {
+/**
+ * @brief Counts of the found words, collected by Dictionary::set_hot_words()
+ */
+struct Hot_Word_Recorder {
+	unordered_map<wstring, size_t> index;
+	vector<pair<wstring, size_t>> counts; // in order of first hit
+};
+} // namespace v3
+
+namespace {
+/**
+ * @brief State of the spell() call running on this thread
+ *
+ * Set by Dict_Base::spell_priv_limited(), which passes its limits, its hot
+ * tier and its recorder to the lookups through it. Without it, e.g. while
+ * suggesting, the work is not limited and the hot tier is not used. The
+ * ranges of the hot tier are over copies of the entries, and the
+ * morphological analysis needs ranges over the real word list.
+ */
+struct Spell_Call {
+	Spell_Work* work = nullptr;
+	size_t max_probes = 0;
+	size_t max_splits = 0;
+	const Hot_Word_List* hot = nullptr;
+	Hot_Word_Recorder* recorder = nullptr;
+};
+thread_local Spell_Call spell_call;
+
+/**
+ * @brief Looks up a word in the word list, counted against the limits
+ *
+ * If the limit is reached, nothing is found. Inside spell_priv_limited(),
+ * the hot tier, if any, is looked up first.
+ */
+auto probe(const Word_List& words, const std::wstring& word)
+{
+	auto& call = spell_call;
+	if (likely(call.work == nullptr))
+		return words.equal_range(word);
+	if (call.work->probes == call.max_probes) {
+		call.work->exhausted = true;
+		return decltype(words.equal_range(word))();
+	}
+	++call.work->probes;
+	if (likely(call.hot == nullptr && call.recorder == nullptr))
+		return words.equal_range(word);
+	auto h = Word_List::hasher()(word);
+	if (call.hot) {
+		auto found = false;
+		auto r = call.hot->equal_range(word, h, found);
+		if (found)
+			return r;
+	}
+	auto r = words.equal_range(word, h);
+	if (call.recorder && r.first != r.second) {
+		auto& rec = *call.recorder;
+		auto [it, is_new] = rec.index.emplace(word, rec.counts.size());
+		if (is_new)
+			rec.counts.emplace_back(word, 0);
+		++rec.counts[it->second].second;
+	}
+	return r;
+}
+
+/**
+ * @brief Counts one tried split of a word against the limits
+ * @return false if the limit is reached and the split should not be tried
+ */
+auto take_split() -> bool
+{
+	auto& call = spell_call;
+	if (likely(call.work == nullptr))
+		return true;
+	if (call.work->splits == call.max_splits) {
+		call.work->exhausted = true;
+		return false;
+	}
+	++call.work->splits;
+	return true;
+}
+} // namespace
+
 /**
  * @brief Check spelling for a word.
  *
@@ -102,6 +199,58 @@ auto Dict_Base::spell_priv(std::wstring& s) const -> bool
 	return ret;
 }
 
+/**
+ * @brief Check spelling for a word with limited work.
+ *
+ * Same as spell_priv(), but the lookups in the word list and the tried
+ * splits of the word are counted and limited. When a limit is reached, the
+ * search stops and the word is rejected, regardless of what was found so
+ * far. This bounds the time for any input, even pathological one.
+ *
+ * @param s string to check spelling for.
+ * @param max_probes the limit of the lookups in the word list.
+ * @param max_splits the limit of the tried splits by compounding and BREAK.
+ * @param[out] work the work done.
+ * @param recorder if not null, counts the words found in the word list.
+ * @return The spelling result, false if a limit was reached.
+ */
+auto Dict_Base::spell_priv_limited(std::wstring& s, size_t max_probes,
+                                   size_t max_splits, Spell_Work& work,
+                                   Hot_Word_Recorder* recorder) const -> bool
+{
+	work = {};
+	auto& call = spell_call;
+	auto old_call = call;
+	auto hot = hot_words.empty() ? nullptr : &hot_words;
+	call = {&work, max_probes, max_splits, hot, recorder};
+	AT_SCOPE_EXIT(call = old_call);
+	auto ret = spell_priv(s);
+	return ret && !work.exhausted;
+}
+
+/**
+ * @brief Checks a word cheaply, only as it is and with one suffix stripped
+ *
+ * No casing variants, prefixes, compounds or BREAK patterns are tried, so
+ * some correct words are rejected. Good enough to tell languages apart.
+ *
+ * @param s word to check.
+ * @return true if found and not forbidden.
+ */
+auto Dict_Base::spell_quick(std::wstring& s) const -> bool
+{
+	for (auto& we : make_iterator_range(probe(words, s))) {
+		auto& word_flags = we.second;
+		if (word_flags.contains(need_affix_flag) ||
+		    word_flags.contains(compound_onlyin_flag) ||
+		    word_flags.contains(HIDDEN_HOMONYM_FLAG))
+			continue;
+		return !word_flags.contains(forbiddenword_flag);
+	}
+	auto res = strip_suffix_only(s, SKIP_HIDDEN_HOMONYM);
+	return res && !res->second.contains(forbiddenword_flag);
+}
+
 /**
  * @brief Checks recursively the spelling according to break patterns.
  *
@@ -128,6 +277,8 @@ auto Dict_Base::spell_break(std::wstring& s, size_t depth) const -> bool
 	// handle break pattern at start of a word
 	for (auto& pat : break_table.start_word_breaks()) {
 		if (s.compare(0, pat.size(), pat) == 0) {
+			if (!take_split())
+				return false;
 			auto substr = s.substr(pat.size());
 			auto res = spell_break(substr);
 			if (res)
@@ -140,6 +291,8 @@ auto Dict_Base::spell_break(std::wstring& s, size_t depth) const -> bool
 		if (pat.size() > s.size())
 			continue;
 		if (s.compare(s.size() - pat.size(), pat.size(), pat) == 0) {
+			if (!take_split())
+				return false;
 			auto substr = s.substr(0, s.size() - pat.size());
 			auto res = spell_break(substr);
 			if (res)
@@ -151,6 +304,8 @@ auto Dict_Base::spell_break(std::wstring& s, size_t depth) const -> bool
 	for (auto& pat : break_table.middle_word_breaks()) {
 		auto i = s.find(pat);
 		if (i > 0 && i < s.size() - pat.size()) {
+			if (!take_split())
+				return false;
 			auto part1 = s.substr(0, i);
 			auto part2 = s.substr(i + pat.size());
 			auto res1 = spell_break(part1, depth + 1);
@@ -350,7 +505,7 @@ auto Dict_Base::check_simple_word(std::wstring& s,
     -> const Flag_Set*
 {
 
-	for (auto& we : make_iterator_range(words.equal_range(s))) {
+	for (auto& we : make_iterator_range(probe(words, s))) {
 		auto& word_flags = we.second;
 		if (word_flags.contains(need_affix_flag))
 			continue;
@@ -499,14 +654,30 @@ auto Dict_Base::is_valid_inside_compound(const Flag_Set& flags) const
 	return true;
 }
 
-template <Affixing_Mode m>
-auto Dict_Base::strip_prefix_only(std::wstring& word,
-                                  Hidden_Homonym skip_hidden_homonym) const
-    -> Affixing_Result<Prefix<wchar_t>>
+/**
+ * @brief Callback for the for_each_* functions that stops at the first result.
+ */
+template <class ResultT>
+class Store_First {
+	ResultT& ret;
+
+      public:
+	Store_First(ResultT& r) : ret(r) {}
+	auto operator()(const ResultT& r)
+	{
+		ret = r;
+		return true;
+	}
+};
+
+template <Affixing_Mode m, class CallbackT>
+auto Dict_Base::for_each_prefix_only(std::wstring& word,
+                                     Hidden_Homonym skip_hidden_homonym,
+                                     CallbackT&& cb) const -> bool
 {
 	auto& dic = words;
 
-	for (auto it = prefixes.iterate_prefixes_of(word); it; ++it) {
+	for (auto it = rules->prefixes.iterate_prefixes_of(word); it; ++it) {
 		auto& e = *it;
 		if (outer_affix_NOT_valid<m>(e))
 			continue;
@@ -516,7 +687,7 @@ auto Dict_Base::strip_prefix_only(std::wstring& word,
 		if (!e.check_condition(word))
 			continue;
 		for (auto& word_entry :
-		     make_iterator_range(dic.equal_range(word))) {
+		     make_iterator_range(probe(dic, word))) {
 			auto& word_flags = word_entry.second;
 			if (!cross_valid_inner_outer(word_flags, e))
 				continue;
@@ -531,19 +702,30 @@ auto Dict_Base::strip_prefix_only(std::wstring& word,
 			if (!is_valid_inside_compound<m>(word_flags) &&
 			    !is_valid_inside_compound<m>(e.cont_flags))
 				continue;
-			return {word_entry, e};
+			if (cb(Affixing_Result<Prefix<wchar_t>>(word_entry, e)))
+				return true;
 		}
 	}
-	return {};
+	return false;
 }
 
 template <Affixing_Mode m>
-auto Dict_Base::strip_suffix_only(std::wstring& word,
+auto Dict_Base::strip_prefix_only(std::wstring& word,
                                   Hidden_Homonym skip_hidden_homonym) const
-    -> Affixing_Result<Suffix<wchar_t>>
+    -> Affixing_Result<Prefix<wchar_t>>
+{
+	auto ret = Affixing_Result<Prefix<wchar_t>>();
+	for_each_prefix_only<m>(word, skip_hidden_homonym, Store_First(ret));
+	return ret;
+}
+
+template <Affixing_Mode m, class CallbackT>
+auto Dict_Base::for_each_suffix_only(std::wstring& word,
+                                     Hidden_Homonym skip_hidden_homonym,
+                                     CallbackT&& cb) const -> bool
 {
 	auto& dic = words;
-	for (auto it = suffixes.iterate_suffixes_of(word); it; ++it) {
+	for (auto it = rules->suffixes.iterate_suffixes_of(word); it; ++it) {
 		auto& e = *it;
 		if (outer_affix_NOT_valid<m>(e))
 			continue;
@@ -556,7 +738,7 @@ auto Dict_Base::strip_suffix_only(std::wstring& word,
 		if (!e.check_condition(word))
 			continue;
 		for (auto& word_entry :
-		     make_iterator_range(dic.equal_range(word))) {
+		     make_iterator_range(probe(dic, word))) {
 			auto& word_flags = word_entry.second;
 			if (!cross_valid_inner_outer(word_flags, e))
 				continue;
@@ -571,10 +753,21 @@ auto Dict_Base::strip_suffix_only(std::wstring& word,
 			if (!is_valid_inside_compound<m>(word_flags) &&
 			    !is_valid_inside_compound<m>(e.cont_flags))
 				continue;
-			return {word_entry, e};
+			if (cb(Affixing_Result<Suffix<wchar_t>>(word_entry, e)))
+				return true;
 		}
 	}
-	return {};
+	return false;
+}
+
+template <Affixing_Mode m>
+auto Dict_Base::strip_suffix_only(std::wstring& word,
+                                  Hidden_Homonym skip_hidden_homonym) const
+    -> Affixing_Result<Suffix<wchar_t>>
+{
+	auto ret = Affixing_Result<Suffix<wchar_t>>();
+	for_each_suffix_only<m>(word, skip_hidden_homonym, Store_First(ret));
+	return ret;
 }
 
 template <Affixing_Mode m>
@@ -582,7 +775,7 @@ auto Dict_Base::strip_prefix_then_suffix(
     std::wstring& word, Hidden_Homonym skip_hidden_homonym) const
     -> Affixing_Result<Suffix<wchar_t>, Prefix<wchar_t>>
 {
-	for (auto it = prefixes.iterate_prefixes_of(word); it; ++it) {
+	for (auto it = rules->prefixes.iterate_prefixes_of(word); it; ++it) {
 		auto& pe = *it;
 		if (pe.cross_product == false)
 			continue;
@@ -607,7 +800,7 @@ auto Dict_Base::strip_pfx_then_sfx_2(const Prefix<wchar_t>& pe,
 {
 	auto& dic = words;
 
-	for (auto it = suffixes.iterate_suffixes_of(word); it; ++it) {
+	for (auto it = rules->suffixes.iterate_suffixes_of(word); it; ++it) {
 		auto& se = *it;
 		if (se.cross_product == false)
 			continue;
@@ -619,7 +812,7 @@ auto Dict_Base::strip_pfx_then_sfx_2(const Prefix<wchar_t>& pe,
 		if (!se.check_condition(word))
 			continue;
 		for (auto& word_entry :
-		     make_iterator_range(dic.equal_range(word))) {
+		     make_iterator_range(probe(dic, word))) {
 			auto& word_flags = word_entry.second;
 			if (!cross_valid_inner_outer(se, pe) &&
 			    !cross_valid_inner_outer(word_flags, pe))
@@ -650,7 +843,7 @@ auto Dict_Base::strip_suffix_then_prefix(
     std::wstring& word, Hidden_Homonym skip_hidden_homonym) const
     -> Affixing_Result<Prefix<wchar_t>, Suffix<wchar_t>>
 {
-	for (auto it = suffixes.iterate_suffixes_of(word); it; ++it) {
+	for (auto it = rules->suffixes.iterate_suffixes_of(word); it; ++it) {
 		auto& se = *it;
 		if (se.cross_product == false)
 			continue;
@@ -675,7 +868,7 @@ auto Dict_Base::strip_sfx_then_pfx_2(const Suffix<wchar_t>& se,
 {
 	auto& dic = words;
 
-	for (auto it = prefixes.iterate_prefixes_of(word); it; ++it) {
+	for (auto it = rules->prefixes.iterate_prefixes_of(word); it; ++it) {
 		auto& pe = *it;
 		if (pe.cross_product == false)
 			continue;
@@ -687,7 +880,7 @@ auto Dict_Base::strip_sfx_then_pfx_2(const Suffix<wchar_t>& se,
 		if (!pe.check_condition(word))
 			continue;
 		for (auto& word_entry :
-		     make_iterator_range(dic.equal_range(word))) {
+		     make_iterator_range(probe(dic, word))) {
 			auto& word_flags = word_entry.second;
 			if (!cross_valid_inner_outer(pe, se) &&
 			    !cross_valid_inner_outer(word_flags, se))
@@ -712,12 +905,12 @@ auto Dict_Base::strip_sfx_then_pfx_2(const Suffix<wchar_t>& se,
 	return {};
 }
 
-template <Affixing_Mode m>
-auto Dict_Base::strip_prefix_then_suffix_commutative(
-    std::wstring& word, Hidden_Homonym skip_hidden_homonym) const
-    -> Affixing_Result<Suffix<wchar_t>, Prefix<wchar_t>>
+template <Affixing_Mode m, class CallbackT>
+auto Dict_Base::for_each_prefix_then_suffix_comm(
+    std::wstring& word, Hidden_Homonym skip_hidden_homonym,
+    CallbackT&& cb) const -> bool
 {
-	for (auto it = prefixes.iterate_prefixes_of(word); it; ++it) {
+	for (auto it = rules->prefixes.iterate_prefixes_of(word); it; ++it) {
 		auto& pe = *it;
 		if (pe.cross_product == false)
 			continue;
@@ -726,25 +919,34 @@ auto Dict_Base::strip_prefix_then_suffix_commutative(
 		To_Root_Unroot_RAII<Prefix<wchar_t>> xxx(word, pe);
 		if (!pe.check_condition(word))
 			continue;
-		auto ret =
-		    strip_pfx_then_sfx_comm_2<m>(pe, word, skip_hidden_homonym);
-		if (ret)
-			return ret;
+		if (for_each_pfx_then_sfx_comm_2<m>(pe, word,
+		                                    skip_hidden_homonym, cb))
+			return true;
 	}
-	return {};
+	return false;
 }
 
 template <Affixing_Mode m>
-auto Dict_Base::strip_pfx_then_sfx_comm_2(
-    const Prefix<wchar_t>& pe, std::wstring& word,
-    Hidden_Homonym skip_hidden_homonym) const
+auto Dict_Base::strip_prefix_then_suffix_commutative(
+    std::wstring& word, Hidden_Homonym skip_hidden_homonym) const
     -> Affixing_Result<Suffix<wchar_t>, Prefix<wchar_t>>
+{
+	auto ret = Affixing_Result<Suffix<wchar_t>, Prefix<wchar_t>>();
+	for_each_prefix_then_suffix_comm<m>(word, skip_hidden_homonym,
+	                                    Store_First(ret));
+	return ret;
+}
+
+template <Affixing_Mode m, class CallbackT>
+auto Dict_Base::for_each_pfx_then_sfx_comm_2(
+    const Prefix<wchar_t>& pe, std::wstring& word,
+    Hidden_Homonym skip_hidden_homonym, CallbackT&& cb) const -> bool
 {
 	auto& dic = words;
 	auto has_needaffix_pe = pe.cont_flags.contains(need_affix_flag);
 	auto is_circumfix_pe = is_circumfix(pe);
 
-	for (auto it = suffixes.iterate_suffixes_of(word); it; ++it) {
+	for (auto it = rules->suffixes.iterate_suffixes_of(word); it; ++it) {
 		auto& se = *it;
 		if (se.cross_product == false)
 			continue;
@@ -759,7 +961,7 @@ auto Dict_Base::strip_pfx_then_sfx_comm_2(
 		if (!se.check_condition(word))
 			continue;
 		for (auto& word_entry :
-		     make_iterator_range(dic.equal_range(word))) {
+		     make_iterator_range(probe(dic, word))) {
 			auto& word_flags = word_entry.second;
 
 			auto valid_cross_pe_outer =
@@ -789,29 +991,43 @@ auto Dict_Base::strip_pfx_then_sfx_comm_2(
 			    !is_valid_inside_compound<m>(se.cont_flags) &&
 			    !is_valid_inside_compound<m>(pe.cont_flags))
 				continue;
-			return {word_entry, se, pe};
+			if (cb(Affixing_Result<Suffix<wchar_t>, Prefix<wchar_t>>(
+			        word_entry, se, pe)))
+				return true;
 		}
 	}
 
-	return {};
+	return false;
 }
 
 template <Affixing_Mode m>
-auto Dict_Base::strip_suffix_then_suffix(
-    std::wstring& word, Hidden_Homonym skip_hidden_homonym) const
-    -> Affixing_Result<Suffix<wchar_t>, Suffix<wchar_t>>
+auto Dict_Base::strip_pfx_then_sfx_comm_2(
+    const Prefix<wchar_t>& pe, std::wstring& word,
+    Hidden_Homonym skip_hidden_homonym) const
+    -> Affixing_Result<Suffix<wchar_t>, Prefix<wchar_t>>
+{
+	auto ret = Affixing_Result<Suffix<wchar_t>, Prefix<wchar_t>>();
+	for_each_pfx_then_sfx_comm_2<m>(pe, word, skip_hidden_homonym,
+	                                Store_First(ret));
+	return ret;
+}
+
+template <Affixing_Mode m, class CallbackT>
+auto Dict_Base::for_each_suffix_then_suffix(
+    std::wstring& word, Hidden_Homonym skip_hidden_homonym,
+    CallbackT&& cb) const -> bool
 {
 	// The following check is purely for performance, it does not change
 	// correctness.
-	if (!suffixes.has_continuation_flags())
-		return {};
+	if (!rules->suffixes.has_continuation_flags())
+		return false;
 
-	for (auto it = suffixes.iterate_suffixes_of(word); it; ++it) {
+	for (auto it = rules->suffixes.iterate_suffixes_of(word); it; ++it) {
 		auto& se1 = *it;
 
 		// The following check is purely for performance, it does not
 		// change correctness.
-		if (!suffixes.has_continuation_flag(se1.flag))
+		if (!rules->suffixes.has_continuation_flag(se1.flag))
 			continue;
 		if (outer_affix_NOT_valid<m>(se1))
 			continue;
@@ -820,24 +1036,34 @@ auto Dict_Base::strip_suffix_then_suffix(
 		To_Root_Unroot_RAII<Suffix<wchar_t>> xxx(word, se1);
 		if (!se1.check_condition(word))
 			continue;
-		auto ret = strip_sfx_then_sfx_2<FULL_WORD>(se1, word,
-		                                           skip_hidden_homonym);
-		if (ret)
-			return ret;
+		if (for_each_sfx_then_sfx_2<FULL_WORD>(
+		        se1, word, skip_hidden_homonym, cb))
+			return true;
 	}
-	return {};
+	return false;
 }
 
 template <Affixing_Mode m>
-auto Dict_Base::strip_sfx_then_sfx_2(const Suffix<wchar_t>& se1,
-                                     std::wstring& word,
-                                     Hidden_Homonym skip_hidden_homonym) const
+auto Dict_Base::strip_suffix_then_suffix(
+    std::wstring& word, Hidden_Homonym skip_hidden_homonym) const
     -> Affixing_Result<Suffix<wchar_t>, Suffix<wchar_t>>
 {
+	auto ret = Affixing_Result<Suffix<wchar_t>, Suffix<wchar_t>>();
+	for_each_suffix_then_suffix<m>(word, skip_hidden_homonym,
+	                               Store_First(ret));
+	return ret;
+}
+
+template <Affixing_Mode m, class CallbackT>
+auto Dict_Base::for_each_sfx_then_sfx_2(const Suffix<wchar_t>& se1,
+                                        std::wstring& word,
+                                        Hidden_Homonym skip_hidden_homonym,
+                                        CallbackT&& cb) const -> bool
+{
 
 	auto& dic = words;
 
-	for (auto it = suffixes.iterate_suffixes_of(word); it; ++it) {
+	for (auto it = rules->suffixes.iterate_suffixes_of(word); it; ++it) {
 		auto& se2 = *it;
 		if (!cross_valid_inner_outer(se2, se1))
 			continue;
@@ -849,7 +1075,7 @@ auto Dict_Base::strip_sfx_then_sfx_2(const Suffix<wchar_t>& se1,
 		if (!se2.check_condition(word))
 			continue;
 		for (auto& word_entry :
-		     make_iterator_range(dic.equal_range(word))) {
+		     make_iterator_range(probe(dic, word))) {
 			auto& word_flags = word_entry.second;
 			if (!cross_valid_inner_outer(word_flags, se2))
 				continue;
@@ -861,27 +1087,41 @@ auto Dict_Base::strip_sfx_then_sfx_2(const Suffix<wchar_t>& se1,
 			    word_flags.contains(HIDDEN_HOMONYM_FLAG))
 				continue;
 			// needflag check here if needed
-			return {word_entry, se2, se1};
+			if (cb(Affixing_Result<Suffix<wchar_t>, Suffix<wchar_t>>(
+			        word_entry, se2, se1)))
+				return true;
 		}
 	}
-	return {};
+	return false;
 }
 
 template <Affixing_Mode m>
-auto Dict_Base::strip_prefix_then_prefix(
-    std::wstring& word, Hidden_Homonym skip_hidden_homonym) const
-    -> Affixing_Result<Prefix<wchar_t>, Prefix<wchar_t>>
+auto Dict_Base::strip_sfx_then_sfx_2(const Suffix<wchar_t>& se1,
+                                     std::wstring& word,
+                                     Hidden_Homonym skip_hidden_homonym) const
+    -> Affixing_Result<Suffix<wchar_t>, Suffix<wchar_t>>
+{
+	auto ret = Affixing_Result<Suffix<wchar_t>, Suffix<wchar_t>>();
+	for_each_sfx_then_sfx_2<m>(se1, word, skip_hidden_homonym,
+	                           Store_First(ret));
+	return ret;
+}
+
+template <Affixing_Mode m, class CallbackT>
+auto Dict_Base::for_each_prefix_then_prefix(
+    std::wstring& word, Hidden_Homonym skip_hidden_homonym,
+    CallbackT&& cb) const -> bool
 {
 	// The following check is purely for performance, it does not change
 	// correctness.
-	if (!prefixes.has_continuation_flags())
-		return {};
+	if (!rules->prefixes.has_continuation_flags())
+		return false;
 
-	for (auto it = prefixes.iterate_prefixes_of(word); it; ++it) {
+	for (auto it = rules->prefixes.iterate_prefixes_of(word); it; ++it) {
 		auto& pe1 = *it;
 		// The following check is purely for performance, it does not
 		// change correctness.
-		if (!prefixes.has_continuation_flag(pe1.flag))
+		if (!rules->prefixes.has_continuation_flag(pe1.flag))
 			continue;
 		if (outer_affix_NOT_valid<m>(pe1))
 			continue;
@@ -890,23 +1130,33 @@ auto Dict_Base::strip_prefix_then_prefix(
 		To_Root_Unroot_RAII<Prefix<wchar_t>> xxx(word, pe1);
 		if (!pe1.check_condition(word))
 			continue;
-		auto ret = strip_pfx_then_pfx_2<FULL_WORD>(pe1, word,
-		                                           skip_hidden_homonym);
-		if (ret)
-			return ret;
+		if (for_each_pfx_then_pfx_2<FULL_WORD>(
+		        pe1, word, skip_hidden_homonym, cb))
+			return true;
 	}
-	return {};
+	return false;
 }
 
 template <Affixing_Mode m>
-auto Dict_Base::strip_pfx_then_pfx_2(const Prefix<wchar_t>& pe1,
-                                     std::wstring& word,
-                                     Hidden_Homonym skip_hidden_homonym) const
+auto Dict_Base::strip_prefix_then_prefix(
+    std::wstring& word, Hidden_Homonym skip_hidden_homonym) const
     -> Affixing_Result<Prefix<wchar_t>, Prefix<wchar_t>>
+{
+	auto ret = Affixing_Result<Prefix<wchar_t>, Prefix<wchar_t>>();
+	for_each_prefix_then_prefix<m>(word, skip_hidden_homonym,
+	                               Store_First(ret));
+	return ret;
+}
+
+template <Affixing_Mode m, class CallbackT>
+auto Dict_Base::for_each_pfx_then_pfx_2(const Prefix<wchar_t>& pe1,
+                                        std::wstring& word,
+                                        Hidden_Homonym skip_hidden_homonym,
+                                        CallbackT&& cb) const -> bool
 {
 	auto& dic = words;
 
-	for (auto it = prefixes.iterate_prefixes_of(word); it; ++it) {
+	for (auto it = rules->prefixes.iterate_prefixes_of(word); it; ++it) {
 		auto& pe2 = *it;
 		if (!cross_valid_inner_outer(pe2, pe1))
 			continue;
@@ -918,7 +1168,7 @@ auto Dict_Base::strip_pfx_then_pfx_2(const Prefix<wchar_t>& pe1,
 		if (!pe2.check_condition(word))
 			continue;
 		for (auto& word_entry :
-		     make_iterator_range(dic.equal_range(word))) {
+		     make_iterator_range(probe(dic, word))) {
 			auto& word_flags = word_entry.second;
 			if (!cross_valid_inner_outer(word_flags, pe2))
 				continue;
@@ -930,23 +1180,37 @@ auto Dict_Base::strip_pfx_then_pfx_2(const Prefix<wchar_t>& pe1,
 			    word_flags.contains(HIDDEN_HOMONYM_FLAG))
 				continue;
 			// needflag check here if needed
-			return {word_entry, pe2, pe1};
+			if (cb(Affixing_Result<Prefix<wchar_t>, Prefix<wchar_t>>(
+			        word_entry, pe2, pe1)))
+				return true;
 		}
 	}
-	return {};
+	return false;
 }
 
 template <Affixing_Mode m>
-auto Dict_Base::strip_prefix_then_2_suffixes(
-    std::wstring& word, Hidden_Homonym skip_hidden_homonym) const
-    -> Affixing_Result<>
+auto Dict_Base::strip_pfx_then_pfx_2(const Prefix<wchar_t>& pe1,
+                                     std::wstring& word,
+                                     Hidden_Homonym skip_hidden_homonym) const
+    -> Affixing_Result<Prefix<wchar_t>, Prefix<wchar_t>>
+{
+	auto ret = Affixing_Result<Prefix<wchar_t>, Prefix<wchar_t>>();
+	for_each_pfx_then_pfx_2<m>(pe1, word, skip_hidden_homonym,
+	                           Store_First(ret));
+	return ret;
+}
+
+template <Affixing_Mode m, class CallbackT>
+auto Dict_Base::for_each_prefix_then_2_suffixes(
+    std::wstring& word, Hidden_Homonym skip_hidden_homonym,
+    CallbackT&& cb) const -> bool
 {
 	// The following check is purely for performance, it does not change
 	// correctness.
-	if (!suffixes.has_continuation_flags())
-		return {};
+	if (!rules->suffixes.has_continuation_flags())
+		return false;
 
-	for (auto i1 = prefixes.iterate_prefixes_of(word); i1; ++i1) {
+	for (auto i1 = rules->prefixes.iterate_prefixes_of(word); i1; ++i1) {
 		auto& pe1 = *i1;
 		if (pe1.cross_product == false)
 			continue;
@@ -955,12 +1219,13 @@ auto Dict_Base::strip_prefix_then_2_suffixes(
 		To_Root_Unroot_RAII<Prefix<wchar_t>> xxx(word, pe1);
 		if (!pe1.check_condition(word))
 			continue;
-		for (auto i2 = suffixes.iterate_suffixes_of(word); i2; ++i2) {
+		for (auto i2 = rules->suffixes.iterate_suffixes_of(word); i2;
+		     ++i2) {
 			auto& se1 = *i2;
 
 			// The following check is purely for performance, it
 			// does not change correctness.
-			if (!suffixes.has_continuation_flag(se1.flag))
+			if (!rules->suffixes.has_continuation_flag(se1.flag))
 				continue;
 
 			if (se1.cross_product == false)
@@ -972,25 +1237,36 @@ auto Dict_Base::strip_prefix_then_2_suffixes(
 			To_Root_Unroot_RAII<Suffix<wchar_t>> yyy(word, se1);
 			if (!se1.check_condition(word))
 				continue;
-			auto ret = strip_pfx_2_sfx_3<FULL_WORD>(
-			    pe1, se1, word, skip_hidden_homonym);
-			if (ret)
-				return ret;
+			if (for_each_pfx_2_sfx_3<FULL_WORD>(
+			        pe1, se1, word, skip_hidden_homonym, cb))
+				return true;
 		}
 	}
-	return {};
+	return false;
 }
 
 template <Affixing_Mode m>
-auto Dict_Base::strip_pfx_2_sfx_3(const Prefix<wchar_t>& pe1,
-                                  const Suffix<wchar_t>& se1,
-                                  std::wstring& word,
-                                  Hidden_Homonym skip_hidden_homonym) const
-    -> Affixing_Result<>
+auto Dict_Base::strip_prefix_then_2_suffixes(
+    std::wstring& word, Hidden_Homonym skip_hidden_homonym) const
+    -> Affixing_Result<Suffix<wchar_t>, Suffix<wchar_t>, Prefix<wchar_t>>
+{
+	auto ret = Affixing_Result<Suffix<wchar_t>, Suffix<wchar_t>,
+	                           Prefix<wchar_t>>();
+	for_each_prefix_then_2_suffixes<m>(word, skip_hidden_homonym,
+	                                   Store_First(ret));
+	return ret;
+}
+
+template <Affixing_Mode m, class CallbackT>
+auto Dict_Base::for_each_pfx_2_sfx_3(const Prefix<wchar_t>& pe1,
+                                     const Suffix<wchar_t>& se1,
+                                     std::wstring& word,
+                                     Hidden_Homonym skip_hidden_homonym,
+                                     CallbackT&& cb) const -> bool
 {
 	auto& dic = words;
 
-	for (auto it = suffixes.iterate_suffixes_of(word); it; ++it) {
+	for (auto it = rules->suffixes.iterate_suffixes_of(word); it; ++it) {
 		auto& se2 = *it;
 		if (!cross_valid_inner_outer(se2, se1))
 			continue;
@@ -1002,7 +1278,7 @@ auto Dict_Base::strip_pfx_2_sfx_3(const Prefix<wchar_t>& pe1,
 		if (!se2.check_condition(word))
 			continue;
 		for (auto& word_entry :
-		     make_iterator_range(dic.equal_range(word))) {
+		     make_iterator_range(probe(dic, word))) {
 			auto& word_flags = word_entry.second;
 			if (!cross_valid_inner_outer(se1, pe1) &&
 			    !cross_valid_inner_outer(word_flags, pe1))
@@ -1017,31 +1293,47 @@ auto Dict_Base::strip_pfx_2_sfx_3(const Prefix<wchar_t>& pe1,
 			    word_flags.contains(HIDDEN_HOMONYM_FLAG))
 				continue;
 			// needflag check here if needed
-			return {word_entry};
+			if (cb(Affixing_Result<Suffix<wchar_t>, Suffix<wchar_t>,
+			                       Prefix<wchar_t>>(
+			        word_entry, se2, se1, pe1)))
+				return true;
 		}
 	}
-
-	return {};
+	return false;
 }
 
 template <Affixing_Mode m>
-auto Dict_Base::strip_suffix_prefix_suffix(
-    std::wstring& word, Hidden_Homonym skip_hidden_homonym) const
-    -> Affixing_Result<>
+auto Dict_Base::strip_pfx_2_sfx_3(const Prefix<wchar_t>& pe1,
+                                  const Suffix<wchar_t>& se1,
+                                  std::wstring& word,
+                                  Hidden_Homonym skip_hidden_homonym) const
+    -> Affixing_Result<Suffix<wchar_t>, Suffix<wchar_t>, Prefix<wchar_t>>
+{
+	auto ret = Affixing_Result<Suffix<wchar_t>, Suffix<wchar_t>,
+	                           Prefix<wchar_t>>();
+	for_each_pfx_2_sfx_3<m>(pe1, se1, word, skip_hidden_homonym,
+	                        Store_First(ret));
+	return ret;
+}
+
+template <Affixing_Mode m, class CallbackT>
+auto Dict_Base::for_each_suffix_prefix_suffix(
+    std::wstring& word, Hidden_Homonym skip_hidden_homonym,
+    CallbackT&& cb) const -> bool
 {
 	// The following check is purely for performance, it does not change
 	// correctness.
-	if (!suffixes.has_continuation_flags() &&
-	    !prefixes.has_continuation_flags())
-		return {};
+	if (!rules->suffixes.has_continuation_flags() &&
+	    !rules->prefixes.has_continuation_flags())
+		return false;
 
-	for (auto i1 = suffixes.iterate_suffixes_of(word); i1; ++i1) {
+	for (auto i1 = rules->suffixes.iterate_suffixes_of(word); i1; ++i1) {
 		auto& se1 = *i1;
 
 		// The following check is purely for performance, it
 		// does not change correctness.
-		if (!suffixes.has_continuation_flag(se1.flag) &&
-		    !prefixes.has_continuation_flag(se1.flag))
+		if (!rules->suffixes.has_continuation_flag(se1.flag) &&
+		    !rules->prefixes.has_continuation_flag(se1.flag))
 			continue;
 
 		if (se1.cross_product == false)
@@ -1051,7 +1343,8 @@ auto Dict_Base::strip_suffix_prefix_suffix(
 		To_Root_Unroot_RAII<Suffix<wchar_t>> xxx(word, se1);
 		if (!se1.check_condition(word))
 			continue;
-		for (auto i2 = prefixes.iterate_prefixes_of(word); i2; ++i2) {
+		for (auto i2 = rules->prefixes.iterate_prefixes_of(word); i2;
+		     ++i2) {
 			auto& pe1 = *i2;
 			if (pe1.cross_product == false)
 				continue;
@@ -1060,24 +1353,35 @@ auto Dict_Base::strip_suffix_prefix_suffix(
 			To_Root_Unroot_RAII<Prefix<wchar_t>> yyy(word, pe1);
 			if (!pe1.check_condition(word))
 				continue;
-			auto ret = strip_s_p_s_3<FULL_WORD>(
-			    se1, pe1, word, skip_hidden_homonym);
-			if (ret)
-				return ret;
+			if (for_each_s_p_s_3<FULL_WORD>(
+			        se1, pe1, word, skip_hidden_homonym, cb))
+				return true;
 		}
 	}
-	return {};
+	return false;
 }
 
 template <Affixing_Mode m>
-auto Dict_Base::strip_s_p_s_3(const Suffix<wchar_t>& se1,
-                              const Prefix<wchar_t>& pe1, std::wstring& word,
-                              Hidden_Homonym skip_hidden_homonym) const
-    -> Affixing_Result<>
+auto Dict_Base::strip_suffix_prefix_suffix(
+    std::wstring& word, Hidden_Homonym skip_hidden_homonym) const
+    -> Affixing_Result<Suffix<wchar_t>, Prefix<wchar_t>, Suffix<wchar_t>>
+{
+	auto ret = Affixing_Result<Suffix<wchar_t>, Prefix<wchar_t>,
+	                           Suffix<wchar_t>>();
+	for_each_suffix_prefix_suffix<m>(word, skip_hidden_homonym,
+	                                 Store_First(ret));
+	return ret;
+}
+
+template <Affixing_Mode m, class CallbackT>
+auto Dict_Base::for_each_s_p_s_3(const Suffix<wchar_t>& se1,
+                                 const Prefix<wchar_t>& pe1, std::wstring& word,
+                                 Hidden_Homonym skip_hidden_homonym,
+                                 CallbackT&& cb) const -> bool
 {
 	auto& dic = words;
 
-	for (auto it = suffixes.iterate_suffixes_of(word); it; ++it) {
+	for (auto it = rules->suffixes.iterate_suffixes_of(word); it; ++it) {
 		auto& se2 = *it;
 		if (se2.cross_product == false)
 			continue;
@@ -1096,7 +1400,7 @@ auto Dict_Base::strip_s_p_s_3(const Suffix<wchar_t>& se1,
 		if (!se2.check_condition(word))
 			continue;
 		for (auto& word_entry :
-		     make_iterator_range(dic.equal_range(word))) {
+		     make_iterator_range(probe(dic, word))) {
 			auto& word_flags = word_entry.second;
 			if (!cross_valid_inner_outer(se2, pe1) &&
 			    !cross_valid_inner_outer(word_flags, pe1))
@@ -1111,11 +1415,26 @@ auto Dict_Base::strip_s_p_s_3(const Suffix<wchar_t>& se1,
 			    word_flags.contains(HIDDEN_HOMONYM_FLAG))
 				continue;
 			// needflag check here if needed
-			return {word_entry};
+			if (cb(Affixing_Result<Suffix<wchar_t>, Prefix<wchar_t>,
+			                       Suffix<wchar_t>>(
+			        word_entry, se2, pe1, se1)))
+				return true;
 		}
 	}
+	return false;
+}
 
-	return {};
+template <Affixing_Mode m>
+auto Dict_Base::strip_s_p_s_3(const Suffix<wchar_t>& se1,
+                              const Prefix<wchar_t>& pe1, std::wstring& word,
+                              Hidden_Homonym skip_hidden_homonym) const
+    -> Affixing_Result<Suffix<wchar_t>, Prefix<wchar_t>, Suffix<wchar_t>>
+{
+	auto ret = Affixing_Result<Suffix<wchar_t>, Prefix<wchar_t>,
+	                           Suffix<wchar_t>>();
+	for_each_s_p_s_3<m>(se1, pe1, word, skip_hidden_homonym,
+	                    Store_First(ret));
+	return ret;
 }
 
 template <Affixing_Mode m>
@@ -1125,17 +1444,17 @@ auto Dict_Base::strip_2_suffixes_then_prefix(
 {
 	// The following check is purely for performance, it does not change
 	// correctness.
-	if (!suffixes.has_continuation_flags() &&
-	    !prefixes.has_continuation_flags())
+	if (!rules->suffixes.has_continuation_flags() &&
+	    !rules->prefixes.has_continuation_flags())
 		return {};
 
-	for (auto i1 = suffixes.iterate_suffixes_of(word); i1; ++i1) {
+	for (auto i1 = rules->suffixes.iterate_suffixes_of(word); i1; ++i1) {
 		auto& se1 = *i1;
 
 		// The following check is purely for performance, it
 		// does not change correctness.
-		if (!suffixes.has_continuation_flag(se1.flag) &&
-		    !prefixes.has_continuation_flag(se1.flag))
+		if (!rules->suffixes.has_continuation_flag(se1.flag) &&
+		    !rules->prefixes.has_continuation_flag(se1.flag))
 			continue;
 
 		if (outer_affix_NOT_valid<m>(se1))
@@ -1145,7 +1464,8 @@ auto Dict_Base::strip_2_suffixes_then_prefix(
 		To_Root_Unroot_RAII<Suffix<wchar_t>> xxx(word, se1);
 		if (!se1.check_condition(word))
 			continue;
-		for (auto i2 = suffixes.iterate_suffixes_of(word); i2; ++i2) {
+		for (auto i2 = rules->suffixes.iterate_suffixes_of(word); i2;
+		     ++i2) {
 			auto& se2 = *i2;
 			if (se2.cross_product == false)
 				continue;
@@ -1172,7 +1492,7 @@ auto Dict_Base::strip_2_sfx_pfx_3(const Suffix<wchar_t>& se1,
 {
 	auto& dic = words;
 
-	for (auto it = prefixes.iterate_prefixes_of(word); it; ++it) {
+	for (auto it = rules->prefixes.iterate_prefixes_of(word); it; ++it) {
 		auto& pe1 = *it;
 		if (pe1.cross_product == false)
 			continue;
@@ -1187,7 +1507,7 @@ auto Dict_Base::strip_2_sfx_pfx_3(const Suffix<wchar_t>& se1,
 		if (!pe1.check_condition(word))
 			continue;
 		for (auto& word_entry :
-		     make_iterator_range(dic.equal_range(word))) {
+		     make_iterator_range(probe(dic, word))) {
 			auto& word_flags = word_entry.second;
 			if (!cross_valid_inner_outer(pe1, se2) &&
 			    !cross_valid_inner_outer(word_flags, se2))
@@ -1209,17 +1529,17 @@ auto Dict_Base::strip_2_sfx_pfx_3(const Suffix<wchar_t>& se1,
 	return {};
 }
 
-template <Affixing_Mode m>
-auto Dict_Base::strip_suffix_then_2_prefixes(
-    std::wstring& word, Hidden_Homonym skip_hidden_homonym) const
-    -> Affixing_Result<>
+template <Affixing_Mode m, class CallbackT>
+auto Dict_Base::for_each_suffix_then_2_prefixes(
+    std::wstring& word, Hidden_Homonym skip_hidden_homonym,
+    CallbackT&& cb) const -> bool
 {
 	// The following check is purely for performance, it does not change
 	// correctness.
-	if (!prefixes.has_continuation_flags())
-		return {};
+	if (!rules->prefixes.has_continuation_flags())
+		return false;
 
-	for (auto i1 = suffixes.iterate_suffixes_of(word); i1; ++i1) {
+	for (auto i1 = rules->suffixes.iterate_suffixes_of(word); i1; ++i1) {
 		auto& se1 = *i1;
 		if (se1.cross_product == false)
 			continue;
@@ -1228,12 +1548,13 @@ auto Dict_Base::strip_suffix_then_2_prefixes(
 		To_Root_Unroot_RAII<Suffix<wchar_t>> xxx(word, se1);
 		if (!se1.check_condition(word))
 			continue;
-		for (auto i2 = prefixes.iterate_prefixes_of(word); i2; ++i2) {
+		for (auto i2 = rules->prefixes.iterate_prefixes_of(word); i2;
+		     ++i2) {
 			auto& pe1 = *i2;
 
 			// The following check is purely for performance, it
 			// does not change correctness.
-			if (!prefixes.has_continuation_flag(pe1.flag))
+			if (!rules->prefixes.has_continuation_flag(pe1.flag))
 				continue;
 
 			if (pe1.cross_product == false)
@@ -1245,25 +1566,36 @@ auto Dict_Base::strip_suffix_then_2_prefixes(
 			To_Root_Unroot_RAII<Prefix<wchar_t>> yyy(word, pe1);
 			if (!pe1.check_condition(word))
 				continue;
-			auto ret = strip_sfx_2_pfx_3<FULL_WORD>(
-			    se1, pe1, word, skip_hidden_homonym);
-			if (ret)
-				return ret;
+			if (for_each_sfx_2_pfx_3<FULL_WORD>(
+			        se1, pe1, word, skip_hidden_homonym, cb))
+				return true;
 		}
 	}
-	return {};
+	return false;
 }
 
 template <Affixing_Mode m>
-auto Dict_Base::strip_sfx_2_pfx_3(const Suffix<wchar_t>& se1,
-                                  const Prefix<wchar_t>& pe1,
-                                  std::wstring& word,
-                                  Hidden_Homonym skip_hidden_homonym) const
-    -> Affixing_Result<>
+auto Dict_Base::strip_suffix_then_2_prefixes(
+    std::wstring& word, Hidden_Homonym skip_hidden_homonym) const
+    -> Affixing_Result<Prefix<wchar_t>, Prefix<wchar_t>, Suffix<wchar_t>>
+{
+	auto ret = Affixing_Result<Prefix<wchar_t>, Prefix<wchar_t>,
+	                           Suffix<wchar_t>>();
+	for_each_suffix_then_2_prefixes<m>(word, skip_hidden_homonym,
+	                                   Store_First(ret));
+	return ret;
+}
+
+template <Affixing_Mode m, class CallbackT>
+auto Dict_Base::for_each_sfx_2_pfx_3(const Suffix<wchar_t>& se1,
+                                     const Prefix<wchar_t>& pe1,
+                                     std::wstring& word,
+                                     Hidden_Homonym skip_hidden_homonym,
+                                     CallbackT&& cb) const -> bool
 {
 	auto& dic = words;
 
-	for (auto it = prefixes.iterate_prefixes_of(word); it; ++it) {
+	for (auto it = rules->prefixes.iterate_prefixes_of(word); it; ++it) {
 		auto& pe2 = *it;
 		if (!cross_valid_inner_outer(pe2, pe1))
 			continue;
@@ -1275,7 +1607,7 @@ auto Dict_Base::strip_sfx_2_pfx_3(const Suffix<wchar_t>& se1,
 		if (!pe2.check_condition(word))
 			continue;
 		for (auto& word_entry :
-		     make_iterator_range(dic.equal_range(word))) {
+		     make_iterator_range(probe(dic, word))) {
 			auto& word_flags = word_entry.second;
 			if (!cross_valid_inner_outer(pe1, se1) &&
 			    !cross_valid_inner_outer(word_flags, se1))
@@ -1289,31 +1621,47 @@ auto Dict_Base::strip_sfx_2_pfx_3(const Suffix<wchar_t>& se1,
 			if (skip_hidden_homonym &&
 			    word_flags.contains(HIDDEN_HOMONYM_FLAG))
 				continue;
-			return {word_entry};
+			if (cb(Affixing_Result<Prefix<wchar_t>, Prefix<wchar_t>,
+			                       Suffix<wchar_t>>(
+			        word_entry, pe2, pe1, se1)))
+				return true;
 		}
 	}
-
-	return {};
+	return false;
 }
 
 template <Affixing_Mode m>
-auto Dict_Base::strip_prefix_suffix_prefix(
-    std::wstring& word, Hidden_Homonym skip_hidden_homonym) const
-    -> Affixing_Result<>
+auto Dict_Base::strip_sfx_2_pfx_3(const Suffix<wchar_t>& se1,
+                                  const Prefix<wchar_t>& pe1,
+                                  std::wstring& word,
+                                  Hidden_Homonym skip_hidden_homonym) const
+    -> Affixing_Result<Prefix<wchar_t>, Prefix<wchar_t>, Suffix<wchar_t>>
+{
+	auto ret = Affixing_Result<Prefix<wchar_t>, Prefix<wchar_t>,
+	                           Suffix<wchar_t>>();
+	for_each_sfx_2_pfx_3<m>(se1, pe1, word, skip_hidden_homonym,
+	                        Store_First(ret));
+	return ret;
+}
+
+template <Affixing_Mode m, class CallbackT>
+auto Dict_Base::for_each_prefix_suffix_prefix(
+    std::wstring& word, Hidden_Homonym skip_hidden_homonym,
+    CallbackT&& cb) const -> bool
 {
 	// The following check is purely for performance, it does not change
 	// correctness.
-	if (!prefixes.has_continuation_flags() &&
-	    !suffixes.has_continuation_flags())
-		return {};
+	if (!rules->prefixes.has_continuation_flags() &&
+	    !rules->suffixes.has_continuation_flags())
+		return false;
 
-	for (auto i1 = prefixes.iterate_prefixes_of(word); i1; ++i1) {
+	for (auto i1 = rules->prefixes.iterate_prefixes_of(word); i1; ++i1) {
 		auto& pe1 = *i1;
 
 		// The following check is purely for performance, it
 		// does not change correctness.
-		if (!prefixes.has_continuation_flag(pe1.flag) &&
-		    !suffixes.has_continuation_flag(pe1.flag))
+		if (!rules->prefixes.has_continuation_flag(pe1.flag) &&
+		    !rules->suffixes.has_continuation_flag(pe1.flag))
 			continue;
 
 		if (pe1.cross_product == false)
@@ -1323,7 +1671,8 @@ auto Dict_Base::strip_prefix_suffix_prefix(
 		To_Root_Unroot_RAII<Prefix<wchar_t>> xxx(word, pe1);
 		if (!pe1.check_condition(word))
 			continue;
-		for (auto i2 = suffixes.iterate_suffixes_of(word); i2; ++i2) {
+		for (auto i2 = rules->suffixes.iterate_suffixes_of(word); i2;
+		     ++i2) {
 			auto& se1 = *i2;
 			if (se1.cross_product == false)
 				continue;
@@ -1332,24 +1681,35 @@ auto Dict_Base::strip_prefix_suffix_prefix(
 			To_Root_Unroot_RAII<Suffix<wchar_t>> yyy(word, se1);
 			if (!se1.check_condition(word))
 				continue;
-			auto ret = strip_p_s_p_3<FULL_WORD>(
-			    pe1, se1, word, skip_hidden_homonym);
-			if (ret)
-				return ret;
+			if (for_each_p_s_p_3<FULL_WORD>(
+			        pe1, se1, word, skip_hidden_homonym, cb))
+				return true;
 		}
 	}
-	return {};
+	return false;
 }
 
 template <Affixing_Mode m>
-auto Dict_Base::strip_p_s_p_3(const Prefix<wchar_t>& pe1,
-                              const Suffix<wchar_t>& se1, std::wstring& word,
-                              Hidden_Homonym skip_hidden_homonym) const
-    -> Affixing_Result<>
+auto Dict_Base::strip_prefix_suffix_prefix(
+    std::wstring& word, Hidden_Homonym skip_hidden_homonym) const
+    -> Affixing_Result<Prefix<wchar_t>, Suffix<wchar_t>, Prefix<wchar_t>>
+{
+	auto ret = Affixing_Result<Prefix<wchar_t>, Suffix<wchar_t>,
+	                           Prefix<wchar_t>>();
+	for_each_prefix_suffix_prefix<m>(word, skip_hidden_homonym,
+	                                 Store_First(ret));
+	return ret;
+}
+
+template <Affixing_Mode m, class CallbackT>
+auto Dict_Base::for_each_p_s_p_3(const Prefix<wchar_t>& pe1,
+                                 const Suffix<wchar_t>& se1, std::wstring& word,
+                                 Hidden_Homonym skip_hidden_homonym,
+                                 CallbackT&& cb) const -> bool
 {
 	auto& dic = words;
 
-	for (auto it = prefixes.iterate_prefixes_of(word); it; ++it) {
+	for (auto it = rules->prefixes.iterate_prefixes_of(word); it; ++it) {
 		auto& pe2 = *it;
 		if (pe2.cross_product == false)
 			continue;
@@ -1368,7 +1728,7 @@ auto Dict_Base::strip_p_s_p_3(const Prefix<wchar_t>& pe1,
 		if (!pe2.check_condition(word))
 			continue;
 		for (auto& word_entry :
-		     make_iterator_range(dic.equal_range(word))) {
+		     make_iterator_range(probe(dic, word))) {
 			auto& word_flags = word_entry.second;
 			if (!cross_valid_inner_outer(pe2, se1) &&
 			    !cross_valid_inner_outer(word_flags, se1))
@@ -1382,11 +1742,26 @@ auto Dict_Base::strip_p_s_p_3(const Prefix<wchar_t>& pe1,
 			if (skip_hidden_homonym &&
 			    word_flags.contains(HIDDEN_HOMONYM_FLAG))
 				continue;
-			return {word_entry};
+			if (cb(Affixing_Result<Prefix<wchar_t>, Suffix<wchar_t>,
+			                       Prefix<wchar_t>>(
+			        word_entry, pe2, se1, pe1)))
+				return true;
 		}
 	}
+	return false;
+}
 
-	return {};
+template <Affixing_Mode m>
+auto Dict_Base::strip_p_s_p_3(const Prefix<wchar_t>& pe1,
+                              const Suffix<wchar_t>& se1, std::wstring& word,
+                              Hidden_Homonym skip_hidden_homonym) const
+    -> Affixing_Result<Prefix<wchar_t>, Suffix<wchar_t>, Prefix<wchar_t>>
+{
+	auto ret = Affixing_Result<Prefix<wchar_t>, Suffix<wchar_t>,
+	                           Prefix<wchar_t>>();
+	for_each_p_s_p_3<m>(pe1, se1, word, skip_hidden_homonym,
+	                    Store_First(ret));
+	return ret;
 }
 
 template <Affixing_Mode m>
@@ -1396,17 +1771,17 @@ auto Dict_Base::strip_2_prefixes_then_suffix(
 {
 	// The following check is purely for performance, it does not change
 	// correctness.
-	if (!prefixes.has_continuation_flags() &&
-	    !suffixes.has_continuation_flags())
+	if (!rules->prefixes.has_continuation_flags() &&
+	    !rules->suffixes.has_continuation_flags())
 		return {};
 
-	for (auto i1 = prefixes.iterate_prefixes_of(word); i1; ++i1) {
+	for (auto i1 = rules->prefixes.iterate_prefixes_of(word); i1; ++i1) {
 		auto& pe1 = *i1;
 
 		// The following check is purely for performance, it
 		// does not change correctness.
-		if (!prefixes.has_continuation_flag(pe1.flag) &&
-		    !suffixes.has_continuation_flag(pe1.flag))
+		if (!rules->prefixes.has_continuation_flag(pe1.flag) &&
+		    !rules->suffixes.has_continuation_flag(pe1.flag))
 			continue;
 
 		if (outer_affix_NOT_valid<m>(pe1))
@@ -1416,7 +1791,8 @@ auto Dict_Base::strip_2_prefixes_then_suffix(
 		To_Root_Unroot_RAII<Prefix<wchar_t>> xxx(word, pe1);
 		if (!pe1.check_condition(word))
 			continue;
-		for (auto i2 = prefixes.iterate_prefixes_of(word); i2; ++i2) {
+		for (auto i2 = rules->prefixes.iterate_prefixes_of(word); i2;
+		     ++i2) {
 			auto& pe2 = *i2;
 			if (pe2.cross_product == false)
 				continue;
@@ -1443,7 +1819,7 @@ auto Dict_Base::strip_2_pfx_sfx_3(const Prefix<wchar_t>& pe1,
 {
 	auto& dic = words;
 
-	for (auto it = suffixes.iterate_suffixes_of(word); it; ++it) {
+	for (auto it = rules->suffixes.iterate_suffixes_of(word); it; ++it) {
 		auto& se1 = *it;
 		if (se1.cross_product == false)
 			continue;
@@ -1458,7 +1834,7 @@ auto Dict_Base::strip_2_pfx_sfx_3(const Prefix<wchar_t>& pe1,
 		if (!se1.check_condition(word))
 			continue;
 		for (auto& word_entry :
-		     make_iterator_range(dic.equal_range(word))) {
+		     make_iterator_range(probe(dic, word))) {
 			auto& word_flags = word_entry.second;
 			if (!cross_valid_inner_outer(se1, pe2) &&
 			    !cross_valid_inner_outer(word_flags, pe2))
@@ -1544,6 +1920,8 @@ auto Dict_Base::check_compound(std::wstring& word, size_t start_pos,
 		return {};
 	size_t max_length = word.size() - min_length;
 	for (auto i = start_pos + min_length; i <= max_length; ++i) {
+		if (!take_split())
+			return {};
 
 		auto part1_entry = check_compound_classic<m>(
 		    word, start_pos, i, num_part, part, input_word_casing);
@@ -1920,7 +2298,7 @@ auto Dict_Base::check_word_in_compound(std::wstring& word) const
 	else if (m == AT_COMPOUND_END)
 		cpd_flag = compound_last_flag;
 
-	auto range = words.equal_range(word);
+	auto range = probe(words, word);
 	for (auto& we : make_iterator_range(range)) {
 		auto& word_flags = we.second;
 		if (word_flags.contains(need_affix_flag))
@@ -2028,10 +2406,12 @@ auto Dict_Base::check_compound_with_rules(
 		return {};
 	size_t max_length = word.size() - min_length;
 	for (auto i = start_pos + min_length; i <= max_length; ++i) {
+		if (!take_split())
+			return {};
 
 		part.assign(word, start_pos, i - start_pos);
 		auto part1_entry = Word_List::const_pointer();
-		auto range = words.equal_range(part);
+		auto range = probe(words, part);
 		for (auto& we : make_iterator_range(range)) {
 			auto& word_flags = we.second;
 			if (word_flags.contains(need_affix_flag))
@@ -2048,7 +2428,7 @@ auto Dict_Base::check_compound_with_rules(
 
 		part.assign(word, i, word.npos);
 		auto part2_entry = Word_List::const_pointer();
-		range = words.equal_range(part);
+		range = probe(words, part);
 		for (auto& we : make_iterator_range(range)) {
 			auto& word_flags = we.second;
 			if (word_flags.contains(need_affix_flag))
@@ -2088,13 +2468,238 @@ auto Dict_Base::check_compound_with_rules(
 	return {};
 }
 
+/**
+ * @brief Calls a callback for every root of a word.
+ *
+ * Unlike spell_priv(), this does not stop at the first valid decomposition.
+ * Every decomposition into a root and up to three affixes is passed to the
+ * callback as Affixing_Result. The affixes are stripped in the same ways as
+ * in check_simple_word(). The title and lower case forms of capitalized
+ * words are tried too. Compound words and break patterns are not decomposed.
+ *
+ * @param word word to decompose, input conversion is applied to it.
+ * @param cb callback, returns true to stop.
+ */
+template <class CallbackT>
+auto Dict_Base::for_each_root(std::wstring& word, CallbackT&& cb) const -> void
+{
+	auto& loc = icu_locale;
+	input_substr_replacer.replace(word);
+	erase_chars(word, ignored_chars);
+	if (word.empty())
+		return;
+	auto casing = classify_casing(word);
+	auto for_each_root_of_form = [&]() {
+		for (auto& we : make_iterator_range(probe(words, word))) {
+			auto& word_flags = we.second;
+			if (word_flags.contains(need_affix_flag))
+				continue;
+			if (word_flags.contains(compound_onlyin_flag))
+				continue;
+			if (word_flags.contains(HIDDEN_HOMONYM_FLAG))
+				continue;
+			if (cb(Affixing_Result<>(we)))
+				return true;
+		}
+		auto skip = SKIP_HIDDEN_HOMONYM;
+		if (for_each_suffix_only<FULL_WORD>(word, skip, cb))
+			return true;
+		if (for_each_prefix_only<FULL_WORD>(word, skip, cb))
+			return true;
+		if (for_each_prefix_then_suffix_comm<FULL_WORD>(word, skip, cb))
+			return true;
+		if (!complex_prefixes) {
+			if (for_each_suffix_then_suffix<FULL_WORD>(word, skip,
+			                                           cb))
+				return true;
+			if (for_each_prefix_then_2_suffixes<FULL_WORD>(
+			        word, skip, cb))
+				return true;
+			return for_each_suffix_prefix_suffix<FULL_WORD>(
+			    word, skip, cb);
+		}
+		if (for_each_prefix_then_prefix<FULL_WORD>(word, skip, cb))
+			return true;
+		if (for_each_suffix_then_2_prefixes<FULL_WORD>(word, skip, cb))
+			return true;
+		return for_each_prefix_suffix_prefix<FULL_WORD>(word, skip,
+		                                                cb);
+	};
+	if (for_each_root_of_form())
+		return;
+	if (casing != Casing::INIT_CAPITAL && casing != Casing::ALL_CAPITAL)
+		return;
+	auto backup = Short_WString(word);
+	AT_SCOPE_EXIT(word = backup);
+	if (casing == Casing::ALL_CAPITAL) {
+		to_title(backup, loc, word);
+		if (for_each_root_of_form())
+			return;
+	}
+	to_lower(backup, loc, word);
+	for_each_root_of_form();
+}
+
+/**
+ * @brief Finds the roots of a word.
+ *
+ * @param word word to stem, input conversion is applied to it.
+ * @param out list where the roots are appended, without duplicates.
+ */
+auto Dict_Base::stem_priv(std::wstring& word, List_WStrings& out) const -> void
+{
+	auto first_new = out.size();
+	for_each_root(word, [&](const Affixing_Result_Base& r) {
+		auto& word_entry = *r;
+		if (word_entry.second.contains(forbiddenword_flag))
+			return false;
+		if (find(begin(out), end(out), word_entry.first) == end(out))
+			out.push_back(word_entry.first);
+		return false;
+	});
+	for (auto i = first_new; i != out.size(); ++i)
+		output_substr_replacer.replace(out[i]);
+}
+
+namespace {
+/**
+ * @brief The affixes of one decomposition, in the order they were stripped.
+ */
+struct Affixes_Of_Root {
+	const Prefix<wchar_t>* prefixes[2] = {}; // outer first
+	const Suffix<wchar_t>* suffixes[2] = {}; // inner first
+};
+auto affixes_of(const Affixing_Result<>&) { return Affixes_Of_Root(); }
+auto affixes_of(const Affixing_Result<Prefix<wchar_t>>& r)
+{
+	auto ret = Affixes_Of_Root();
+	ret.prefixes[0] = r.a;
+	return ret;
+}
+auto affixes_of(const Affixing_Result<Suffix<wchar_t>>& r)
+{
+	auto ret = Affixes_Of_Root();
+	ret.suffixes[0] = r.a;
+	return ret;
+}
+auto affixes_of(const Affixing_Result<Suffix<wchar_t>, Prefix<wchar_t>>& r)
+{
+	auto ret = Affixes_Of_Root();
+	ret.suffixes[0] = r.a;
+	ret.prefixes[0] = r.b;
+	return ret;
+}
+auto affixes_of(const Affixing_Result<Suffix<wchar_t>, Suffix<wchar_t>>& r)
+{
+	auto ret = Affixes_Of_Root();
+	ret.suffixes[0] = r.a;
+	ret.suffixes[1] = r.b;
+	return ret;
+}
+auto affixes_of(const Affixing_Result<Prefix<wchar_t>, Prefix<wchar_t>>& r)
+{
+	auto ret = Affixes_Of_Root();
+	ret.prefixes[0] = r.b;
+	ret.prefixes[1] = r.a;
+	return ret;
+}
+auto affixes_of(const Affixing_Result<Suffix<wchar_t>, Suffix<wchar_t>,
+                                      Prefix<wchar_t>>& r)
+{
+	auto ret = Affixes_Of_Root();
+	ret.suffixes[0] = r.a;
+	ret.suffixes[1] = r.b;
+	ret.prefixes[0] = r.c;
+	return ret;
+}
+auto affixes_of(const Affixing_Result<Suffix<wchar_t>, Prefix<wchar_t>,
+                                      Suffix<wchar_t>>& r)
+{
+	auto ret = Affixes_Of_Root();
+	ret.suffixes[0] = r.a;
+	ret.prefixes[0] = r.b;
+	ret.suffixes[1] = r.c;
+	return ret;
+}
+auto affixes_of(const Affixing_Result<Prefix<wchar_t>, Prefix<wchar_t>,
+                                      Suffix<wchar_t>>& r)
+{
+	auto ret = Affixes_Of_Root();
+	ret.prefixes[0] = r.b;
+	ret.prefixes[1] = r.a;
+	ret.suffixes[0] = r.c;
+	return ret;
+}
+auto affixes_of(const Affixing_Result<Prefix<wchar_t>, Suffix<wchar_t>,
+                                      Prefix<wchar_t>>& r)
+{
+	auto ret = Affixes_Of_Root();
+	ret.prefixes[0] = r.c;
+	ret.prefixes[1] = r.a;
+	ret.suffixes[0] = r.b;
+	return ret;
+}
+} // namespace
+
+/**
+ * @brief Morphological analysis of a word.
+ *
+ * For every decomposition, appends one analysis consisting of the stem
+ * field "st:" followed by the morphological fields of the prefixes, of the
+ * root and of the suffixes.
+ *
+ * @param word word to analyze, input conversion is applied to it.
+ * @param out list where the analyses are appended, without duplicates.
+ */
+auto Dict_Base::analyze_priv(std::wstring& word, List_WStrings& out) const
+    -> void
+{
+	auto analysis = wstring();
+	auto wide_fields = wstring();
+	auto append_fields = [&](string_view fields) {
+		if (fields.empty())
+			return;
+		utf8_to_wide(string(fields), wide_fields);
+		analysis += ' ';
+		analysis += wide_fields;
+	};
+	for_each_root(word, [&](const auto& r) {
+		auto& word_entry = *r;
+		if (word_entry.second.contains(forbiddenword_flag))
+			return false;
+		auto affixes = affixes_of(r);
+		analysis.clear();
+		for (auto p : affixes.prefixes)
+			if (p)
+				append_fields(morph_table.get(p->morph_fields));
+		wide_fields = word_entry.first;
+		output_substr_replacer.replace(wide_fields);
+		analysis += L" st:";
+		analysis += wide_fields;
+		append_fields(morph_table.get_word_fields(words, word_entry));
+		for (auto s : affixes.suffixes)
+			if (s)
+				append_fields(morph_table.get(s->morph_fields));
+		analysis.erase(0, 1);
+		if (find(begin(out), end(out), analysis) == end(out))
+			out.push_back(analysis);
+		return false;
+	});
+}
+
 auto static insert_sug_first(const wstring& word, List_WStrings& out)
 {
 		out.insert(begin(out), word);
 }
 
-auto Dict_Base::suggest_priv(std::wstring& word, List_WStrings& out) const
-    -> void
+auto static is_cancelled(const Cancellation_Token* token)
+{
+	return token && token->is_cancelled();
+}
+
+auto Dict_Base::suggest_priv(std::wstring& word, List_WStrings& out,
+                             const Cancellation_Token* token,
+                             Executor* executor) const -> void
 {
 	if (word.empty())
 		return;
@@ -2112,16 +2717,16 @@ auto Dict_Base::suggest_priv(std::wstring& word, List_WStrings& out) const
 	auto casing = classify_casing(word);
 	switch (casing) {
 	case Casing::SMALL:
-		suggest_low(word, out);
+		suggest_low(word, out, token);
 		break;
 	case Casing::INIT_CAPITAL:
-		suggest_low(word, out);
+		suggest_low(word, out, token);
 		to_lower(word, icu_locale, word);
-		suggest_low(word, out);
+		suggest_low(word, out, token);
 		break;
 	case Casing::CAMEL:
 	case Casing::PASCAL: {
-		suggest_low(word, out);
+		suggest_low(word, out, token);
 		auto dot_idx = word.find('.');
 		if (dot_idx != word.npos) {
 			auto after_dot = wstring_view(word).substr(dot_idx + 1);
@@ -2136,17 +2741,17 @@ auto Dict_Base::suggest_priv(std::wstring& word, List_WStrings& out) const
 			to_lower_char_at(word, 0, icu_locale);
 			if (spell_priv(word))
 				insert_sug_first(word, out);
-			suggest_low(word, out);
+			suggest_low(word, out, token);
 		}
 		to_lower(backup, icu_locale, word);
 		if (spell_priv(word))
 			insert_sug_first(word, out);
-		suggest_low(word, out);
+		suggest_low(word, out, token);
 		if (casing == Casing::PASCAL) {
 			to_title(backup, icu_locale, word);
 			if (spell_priv(word))
 				insert_sug_first(word, out);
-			suggest_low(word, out);
+			suggest_low(word, out, token);
 		}
 		for (auto it = begin(out); it != end(out); ++it) {
 			auto& sug = *it;
@@ -2169,9 +2774,9 @@ auto Dict_Base::suggest_priv(std::wstring& word, List_WStrings& out) const
 		to_lower(backup, icu_locale, word);
 		if (keepcase_flag != 0 && spell_priv(word))
 			insert_sug_first(word, out);
-		suggest_low(word, out);
+		suggest_low(word, out, token);
 		to_title(backup, icu_locale, word);
-		suggest_low(word, out);
+		suggest_low(word, out, token);
 		for (auto& sug : out)
 			to_upper(sug, icu_locale, sug);
 		break;
@@ -2183,29 +2788,8 @@ auto Dict_Base::suggest_priv(std::wstring& word, List_WStrings& out) const
 	    has_dash && any_of(begin(out), end(out), [](const wstring& s) {
 		    return s.find('-') != s.npos;
 	    });
-	if (has_dash && !has_dash_sug) {
-		auto sugs_tmp = List_WStrings();
-		auto i = size_t();
-		for (;;) {
-			auto j = orig_word.find('-', i);
-			word.assign(orig_word, i, j - i);
-			if (!spell_priv(word)) {
-				suggest_priv(word, sugs_tmp);
-				for (auto& t : sugs_tmp) {
-					word = backup;
-					word.replace(i, j - i, t);
-					auto flg =
-					    check_word(word, Casing::SMALL);
-					if (!flg ||
-					    !flg->contains(forbiddenword_flag))
-						out.push_back(word);
-				}
-			}
-			if (j == orig_word.npos)
-				break;
-			i = j + 1;
-		}
-	}
+	if (has_dash && !has_dash_sug)
+		suggest_hyphenated(word, orig_word, out, token, executor);
 	word = backup;
 
 	if (casing == Casing::INIT_CAPITAL || casing == Casing::PASCAL) {
@@ -2255,21 +2839,53 @@ auto Dict_Base::suggest_priv(std::wstring& word, List_WStrings& out) const
 		output_substr_replacer.replace(sug);
 }
 
-auto Dict_Base::suggest_low(std::wstring& word, List_WStrings& out) const
-    -> void
+/**
+ * @brief Runs all suggestion generators on a word
+ *
+ * The token is checked before each generator, so cancellation takes effect
+ * quickly and leaves the suggestions that were found so far in @p out.
+ */
+auto Dict_Base::suggest_low(std::wstring& word, List_WStrings& out,
+                            const Cancellation_Token* token) const -> void
 {
+	if (is_cancelled(token))
+		return;
 	uppercase_suggest(word, out);
+	if (is_cancelled(token))
+		return;
 	rep_suggest(word, out);
+	if (is_cancelled(token))
+		return;
 	map_suggest(word, out);
+	if (is_cancelled(token))
+		return;
 	adjacent_swap_suggest(word, out);
+	if (is_cancelled(token))
+		return;
 	distant_swap_suggest(word, out);
+	if (is_cancelled(token))
+		return;
 	keyboard_suggest(word, out);
+	if (is_cancelled(token))
+		return;
 	extra_char_suggest(word, out);
+	if (is_cancelled(token))
+		return;
 	forgotten_char_suggest(word, out);
+	if (is_cancelled(token))
+		return;
 	move_char_suggest(word, out);
+	if (is_cancelled(token))
+		return;
 	bad_char_suggest(word, out);
+	if (is_cancelled(token))
+		return;
 	doubled_two_chars_suggest(word, out);
+	if (is_cancelled(token))
+		return;
 	two_words_suggest(word, out);
+	if (is_cancelled(token))
+		return;
 	phonetic_suggest(word, out);
 }
 
@@ -2300,7 +2916,7 @@ auto Dict_Base::rep_suggest(std::wstring& word, List_WStrings& out) const
 
     -> void
 {
-	auto& reps = replacements;
+	auto& reps = rules->replacements;
 	for (auto& r : reps.whole_word_replacements()) {
 		auto& from = r.first;
 		auto& to = r.second;
@@ -2363,7 +2979,7 @@ auto Dict_Base::try_rep_suggestion(std::wstring& word, List_WStrings& out) const
 
 auto Dict_Base::is_rep_similar(std::wstring& word) const -> bool
 {
-	auto& reps = replacements;
+	auto& reps = rules->replacements;
 	for (auto& r : reps.whole_word_replacements()) {
 		auto& from = r.first;
 		auto& to = r.second;
@@ -2418,7 +3034,7 @@ auto Dict_Base::map_suggest(std::wstring& word, List_WStrings& out,
                             size_t i) const -> void
 {
 	for (; i != word.size(); ++i) {
-		for (auto& e : similarities) {
+		for (auto& e : rules->similarities) {
 			auto j = e.chars.find(word[i]);
 			if (j == word.npos)
 				goto try_find_strings;
@@ -2657,7 +3273,7 @@ auto Dict_Base::phonetic_suggest(std::wstring& word, List_WStrings& out) const
 	auto backup = Short_WString(word);
 	transform(begin(word), end(word), begin(word),
 	          [](auto c) { return u_toupper(c); });
-	auto changed = phonetic_table.replace(word);
+	auto changed = rules->phonetic_table.replace(word);
 	if (changed) {
 		transform(begin(word), end(word), begin(word),
 		          [](auto c) { return u_tolower(c); });
@@ -2666,107 +3282,575 @@ auto Dict_Base::phonetic_suggest(std::wstring& word, List_WStrings& out) const
 	word = backup;
 }
 
-Dictionary::Dictionary(std::istream& aff, std::istream& dic)
-    : external_locale_known_utf8(true)
-{
-	if (!parse_aff_dic(aff, dic))
-		throw Dictionary_Loading_Error("error parsing");
-}
+namespace {
+// Bumped by Dictionary::trim(), observed lazily by every thread and cache.
+atomic<unsigned> trim_scratch_gen = 0;
+atomic<unsigned> trim_cache_gen = 0;
 
-auto Dictionary::external_to_internal_encoding(const string& in,
-                                               wstring& wide_out) const -> bool
-{
-	if (external_locale_known_utf8)
-		return utf8_to_wide(in, wide_out);
-	else
-		return to_wide(in, external_locale, wide_out);
-}
+atomic<size_t> cache_budget = numeric_limits<size_t>::max();
+atomic<size_t> cache_usage = 0;
 
-auto Dictionary::internal_to_external_encoding(const wstring& wide_in,
-                                               string& out) const -> bool
+auto try_charge_cache(size_t bytes) -> bool
 {
-	if (external_locale_known_utf8)
-		wide_to_utf8(wide_in, out);
-	else
-		return to_narrow(wide_in, out, external_locale);
+	auto used = cache_usage.load();
+	do {
+		auto budget = cache_budget.load();
+		if (used > budget || bytes > budget - used)
+			return false;
+	} while (!cache_usage.compare_exchange_weak(used, used + bytes));
 	return true;
 }
 
-Dictionary::Dictionary() : external_locale_known_utf8(true) {}
+auto release_cache(size_t bytes) -> void { cache_usage -= bytes; }
+
+struct Thread_Scratch {
+	wstring wide_word;
+	List_WStrings wide_list;
+	string narrow_word;
+	unsigned generation = trim_scratch_gen;
+};
 
 /**
- * @brief Create a dictionary from opened files as iostreams
- *
- * Prefer using load_from_path(). Use this if you have a specific use case,
- * like when .aff and .dic are in-memory buffers istringstream.
+ * @brief Gets the buffers of the calling thread used by the public functions
  *
- * @param aff The iostream of the .aff file
- * @param dic The iostream of the .dic file
- * @return Dictionary object
- * @throws Dictionary_Loading_Error on error
+ * After Dictionary::trim() the buffers are freed on the next call.
  */
-auto Dictionary::load_from_aff_dic(std::istream& aff, std::istream& dic)
-    -> Dictionary
+auto get_thread_scratch() -> Thread_Scratch&
 {
-	return Dictionary(aff, dic);
+	auto static thread_local scratch = Thread_Scratch();
+	auto gen = trim_scratch_gen.load(memory_order_relaxed);
+	if (unlikely(scratch.generation != gen)) {
+		scratch.wide_word = wstring();
+		scratch.wide_list = List_WStrings();
+		scratch.narrow_word = string();
+		scratch.generation = gen;
+	}
+	return scratch;
 }
 
 /**
- * @brief Create a dictionary from files
- * @param file_path_without_extension path *without* extensions (without .dic or
- * .aff)
- * @return Dictionary object
- * @throws Dictionary_Loading_Error on error
+ * @brief Read-only contents of a file, memory-mapped where possible
  */
-auto Dictionary::load_from_path(const std::string& file_path_without_extension)
-    -> Dictionary
-{
-	auto path = file_path_without_extension;
-	path += ".aff";
-	std::ifstream aff_file(path);
-	if (aff_file.fail()) {
-		auto err = "Aff file " + path + " not found";
-		throw Dictionary_Loading_Error(err);
+class Mapped_File {
+	string_view contents;
+	bool mapped = false;
+	string buffer;
+
+      public:
+	explicit Mapped_File(const string& path)
+	{
+#ifdef _POSIX_VERSION
+		auto fd = ::open(path.c_str(), O_RDONLY);
+		if (fd == -1)
+			return;
+		struct stat st;
+		if (fstat(fd, &st) == 0 && st.st_size > 0) {
+			auto size = size_t(st.st_size);
+			auto p = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd,
+			              0);
+			if (p != MAP_FAILED) {
+				contents = {static_cast<const char*>(p), size};
+				mapped = true;
+			}
+		}
+		::close(fd);
+		if (mapped)
+			return;
+#endif
+		auto in = ifstream(path, ios_base::binary);
+		buffer.assign(istreambuf_iterator<char>(in), {});
+		contents = buffer;
 	}
-	path.replace(path.size() - 3, 3, "dic");
-	std::ifstream dic_file(path);
-	if (dic_file.fail()) {
-		auto err = "Dic file " + path + " not found";
-		throw Dictionary_Loading_Error(err);
+	Mapped_File(const Mapped_File&) = delete;
+	auto operator=(const Mapped_File&) = delete;
+	~Mapped_File()
+	{
+#ifdef _POSIX_VERSION
+		if (mapped)
+			munmap(const_cast<char*>(contents.data()),
+			       contents.size());
+#endif
 	}
-	return load_from_aff_dic(aff_file, dic_file);
-}
+	auto data() const { return contents; }
+};
 
 /**
- * @brief Sets external (public API) encoding
- *
- * By external encoding we mean the encoding of the strings that you are going
- * to pass to other functions like spell() and suggest(). This function should
- * be used rarely, as the default external encoding is UTF-8.
- *
- * This encoding should not be misunderstood with the internal encoding or with
- * the encoding of the dictionary files (.dic and .aff). It can be different
- * than any of them.
- *
- * The locale must contain std::codecvt<wchar_t, char, mbstate_t> facet that can
- * convert the strings from the external locale to UTF-32 on non-Windows
- * platforms, and to UTF-16 on Windows.
+ * @brief Sidecar cache file of structures derived from a dictionary
  *
- * @param loc locale object with valid codecvt<wchar_t, char, mbstate_t>
+ * Layout, in native byte order: the magic NUSPCACH, u32 format version,
+ * u32 number of hot words, u64 hash of everything the contents derive
+ * from, then each hot word as u32 byte length and UTF-8 bytes.
  */
-auto Dictionary::imbue(const locale& loc) -> void
+constexpr auto SIDECAR_MAGIC = string_view("NUSPCACH");
+constexpr auto SIDECAR_VERSION = uint32_t(1);
+
+template <class T>
+auto read_pod(string_view& in, T& x) -> bool
 {
-	external_locale = loc;
-	external_locale_known_utf8 = is_locale_known_utf8(external_locale);
+	if (in.size() < sizeof(T))
+		return false;
+	memcpy(&x, in.data(), sizeof(T));
+	in.remove_prefix(sizeof(T));
+	return true;
 }
 
 /**
- * @brief Sets external (public API) encoding to UTF-8
- *
- * Call this only if you used imbue() and want to revert it to UTF-8.
+ * @brief Reads the hot words from the sidecar if it matches the hash
+ */
+auto read_sidecar(const string& path, uint64_t hash, vector<wstring>& keys)
+    -> bool
+{
+	auto file = Mapped_File(path);
+	auto in = file.data();
+	if (in.substr(0, SIDECAR_MAGIC.size()) != SIDECAR_MAGIC)
+		return false;
+	in.remove_prefix(SIDECAR_MAGIC.size());
+	uint32_t version, num_keys;
+	uint64_t file_hash;
+	if (!read_pod(in, version) || !read_pod(in, num_keys) ||
+	    !read_pod(in, file_hash))
+		return false;
+	if (version != SIDECAR_VERSION || file_hash != hash)
+		return false;
+	keys.clear();
+	auto key = string();
+	for (uint32_t i = 0; i != num_keys; ++i) {
+		uint32_t len;
+		if (!read_pod(in, len) || in.size() < len)
+			return false;
+		key.assign(in.substr(0, len));
+		in.remove_prefix(len);
+		keys.push_back(utf8_to_wide(key));
+	}
+	return in.empty();
+}
+
+/**
+ * @brief Writes the sidecar atomically, to a temporary file then renamed
+ *
+ * The temporary file is unique for each call in the process, and with the
+ * process id, on POSIX, for each process, so concurrent writers never write
+ * to the same temporary file. It is removed if writing fails.
+ */
+auto write_sidecar(const string& path, uint64_t hash,
+                   const vector<wstring>& keys) -> bool
+{
+	static auto num_writes = atomic<unsigned long>();
+	auto tmp_path = path + ".tmp";
+#ifdef _POSIX_VERSION
+	tmp_path += to_string(getpid());
+	tmp_path += '.';
+#endif
+	tmp_path += to_string(num_writes++);
+	{
+		auto out = ofstream(tmp_path, ios_base::binary);
+		auto write_pod = [&](auto x) {
+			out.write(reinterpret_cast<const char*>(&x), sizeof(x));
+		};
+		out.write(SIDECAR_MAGIC.data(), SIDECAR_MAGIC.size());
+		write_pod(SIDECAR_VERSION);
+		write_pod(uint32_t(keys.size()));
+		write_pod(hash);
+		auto key = string();
+		for (auto& k : keys) {
+			wide_to_utf8(k, key);
+			write_pod(uint32_t(key.size()));
+			out.write(key.data(), key.size());
+		}
+		out.close();
+		if (!out) {
+			remove(tmp_path.c_str());
+			return false;
+		}
+	}
+#ifdef _WIN32
+	remove(path.c_str()); // rename does not replace on Windows
+#endif
+	if (rename(tmp_path.c_str(), path.c_str()) != 0) {
+		remove(tmp_path.c_str());
+		return false;
+	}
+	return true;
+}
+} // namespace
+
+inline namespace v3 {
+/**
+ * @brief Cache of the verdicts and suggestions for segments of hyphenated
+ * words
+ *
+ * Segments like "e" or "mail" recur in many words. The cache counts towards
+ * the global cache budget and is dropped after Dictionary::trim(). It also
+ * has its own limit, when it is reached the cache is cleared and refilled
+ * with the recent segments. It is shared by the threads, so it is guarded by
+ * a mutex.
+ */
+struct Segment_Cache {
+	struct Entry {
+		bool correct = false;
+		List_WStrings sugs;
+	};
+	static constexpr size_t MAX_BYTES = size_t(1) << 20;
+	mutex mtx;
+	unordered_map<wstring, Entry> map;
+	size_t bytes = 0;
+	unsigned generation = trim_cache_gen;
+
+	~Segment_Cache() { release_cache(bytes); }
+	auto clear() -> void
+	{
+		map = {};
+		release_cache(bytes);
+		bytes = 0;
+	}
+	auto sync_generation() -> void
+	{
+		auto gen = trim_cache_gen.load(memory_order_relaxed);
+		if (likely(generation == gen))
+			return;
+		clear();
+		generation = gen;
+	}
+	auto get(const wstring& segment, Entry& out) -> bool
+	{
+		auto lock = lock_guard(mtx);
+		sync_generation();
+		auto it = map.find(segment);
+		if (it == end(map))
+			return false;
+		out = it->second;
+		return true;
+	}
+	auto put(const wstring& segment, const Entry& e) -> void
+	{
+		// node with the key, next pointer, hash and bucket
+		auto cost = sizeof(decltype(map)::value_type) +
+		            segment.size() * sizeof(wchar_t) + 3 * sizeof(void*);
+		for (auto& sug : e.sugs)
+			cost += sizeof(wstring) + sug.size() * sizeof(wchar_t);
+		auto lock = lock_guard(mtx);
+		sync_generation();
+		if (map.count(segment) || cost > MAX_BYTES)
+			return;
+		if (bytes + cost > MAX_BYTES)
+			clear();
+		if (!try_charge_cache(cost))
+			return;
+		map.emplace(segment, e);
+		bytes += cost;
+	}
+};
+} // namespace v3
+
+Dict_Base::Dict_Base()
+    : Aff_Data(), // we explicity do value init so content is zeroed
+      segment_cache(make_shared<Segment_Cache>())
+{
+}
+
+/**
+ * @brief Suggests for a hyphenated word by correcting its segments
+ *
+ * Every misspelled segment between the dashes is replaced by each of its
+ * suggestions. Each distinct segment is checked once and the results are
+ * cached across calls. When several segments miss the cache and an executor
+ * is given, they are processed in parallel on it, otherwise one after
+ * another.
+ *
+ * @param word buffer, its content is lost
+ * @param orig_word the hyphenated word
+ * @param out the suggestions are appended here
+ * @param token token that can cancel the work
+ * @param executor executor for the segments, or null
+ */
+auto Dict_Base::suggest_hyphenated(std::wstring& word,
+                                   std::wstring_view orig_word,
+                                   List_WStrings& out,
+                                   const Cancellation_Token* token,
+                                   Executor* executor) const -> void
+{
+	using Entry = Segment_Cache::Entry;
+	struct Segment {
+		size_t pos;
+		size_t len;
+		size_t id; // index in distinct
+	};
+	auto segments = vector<Segment>();
+	auto distinct = vector<wstring>();
+	for (size_t i = 0;;) {
+		auto j = orig_word.find('-', i);
+		auto len = min(j, orig_word.size()) - i;
+		auto seg = orig_word.substr(i, len);
+		auto it = find(begin(distinct), end(distinct), seg);
+		if (it == end(distinct))
+			it = distinct.emplace(it, seg);
+		segments.push_back({i, len, size_t(it - begin(distinct))});
+		if (j == orig_word.npos)
+			break;
+		i = j + 1;
+	}
+	auto entries = vector<Entry>(distinct.size());
+	auto missing = vector<size_t>();
+	for (size_t k = 0; k != distinct.size(); ++k) {
+		auto& cache = segment_cache;
+		if (!cache || !cache->get(distinct[k], entries[k]))
+			missing.push_back(k);
+	}
+
+	auto fill_entry = [&](size_t k, wstring& buf) {
+		auto& e = entries[k];
+		buf = distinct[k];
+		e.correct = spell_priv(buf);
+		if (!e.correct) {
+			buf = distinct[k];
+			suggest_priv(buf, e.sugs, token);
+		}
+		// suggestions of a cancelled search are incomplete
+		if (segment_cache && !is_cancelled(token))
+			segment_cache->put(distinct[k], e);
+	};
+	if (missing.size() > 1 && executor) {
+		// Same scheme as in Dictionary::suggest_batch(). Tasks that
+		// start late find no work left and do not touch the captures.
+		struct Segments_State {
+			mutex mtx;
+			condition_variable cv;
+			size_t next = 0;
+			size_t num_active = 0;
+			exception_ptr error;
+		};
+		auto state = make_shared<Segments_State>();
+		auto num = missing.size();
+		auto work = [&, state, num]() {
+			auto buf = wstring();
+			auto lock = unique_lock<mutex>(state->mtx);
+			for (;;) {
+				if (state->error || state->next == num)
+					return;
+				auto m = state->next++;
+				++state->num_active;
+				lock.unlock();
+				try {
+					if (!is_cancelled(token))
+						fill_entry(missing[m], buf);
+					lock.lock();
+				}
+				catch (...) {
+					lock.lock();
+					if (!state->error)
+						state->error =
+						    current_exception();
+				}
+				if (--state->num_active == 0)
+					state->cv.notify_all();
+			}
+		};
+		auto num_tasks = min(executor->concurrency(), num);
+		for (size_t i = 1; i < num_tasks; ++i)
+			executor->execute(work);
+		work();
+		auto lock = unique_lock<mutex>(state->mtx);
+		state->cv.wait(lock, [&] {
+			return (state->error || state->next == num) &&
+			       state->num_active == 0;
+		});
+		if (state->error)
+			rethrow_exception(state->error);
+	}
+	else {
+		for (auto k : missing) {
+			if (is_cancelled(token))
+				break;
+			fill_entry(k, word);
+		}
+	}
+
+	for (auto& seg : segments) {
+		auto& e = entries[seg.id];
+		if (e.correct)
+			continue;
+		for (auto& t : e.sugs) {
+			word = orig_word;
+			word.replace(seg.pos, seg.len, t);
+			auto flg = check_word(word, Casing::SMALL);
+			if (!flg || !flg->contains(forbiddenword_flag))
+				out.push_back(word);
+		}
+	}
+}
+
+inline namespace v3 {
+/**
+ * @brief Sets the limit for the memory of all optional caches
+ *
+ * The limit is process-wide and counts the caches of all dictionaries and
+ * helper objects like Identifier_Checker. When a cache reaches the limit it
+ * stops growing. If the new limit is below the current usage, the caches are
+ * dropped and rebuilt within the new limit. The default is unlimited.
+ *
+ * @param bytes the limit in bytes
+ */
+auto set_cache_budget(size_t bytes) -> void
+{
+	cache_budget = bytes;
+	if (cache_usage > bytes)
+		++trim_cache_gen;
+}
+
+auto get_cache_budget() -> size_t { return cache_budget; }
+
+/**
+ * @brief Returns the memory in bytes currently used by all optional caches
+ */
+auto get_cache_usage() -> size_t { return cache_usage; }
+} // namespace v3
+
+Dictionary::Dictionary(std::istream& aff, std::istream& dic)
+    : external_locale_known_utf8(true)
+{
+	if (!parse_aff_dic(aff, dic))
+		throw Dictionary_Loading_Error("error parsing");
+}
+
+auto Dictionary::external_to_internal_encoding(const string& in,
+                                               wstring& wide_out) const -> bool
+{
+	if (external_locale_known_utf8)
+		return utf8_to_wide(in, wide_out);
+	else
+		return to_wide(in, external_locale, wide_out);
+}
+
+auto Dictionary::internal_to_external_encoding(const wstring& wide_in,
+                                               string& out) const -> bool
+{
+	if (external_locale_known_utf8)
+		wide_to_utf8(wide_in, out);
+	else
+		return to_narrow(wide_in, out, external_locale);
+	return true;
+}
+
+/**
+ * @brief Converts a word given to spell(), suggest() etc. to wide string
+ *
+ * Words longer than 180 code units are rejected and the buffer is shrunk,
+ * so one very long input does not keep a big buffer alive.
+ *
+ * @param in word in the external encoding
+ * @param[out] wide_out the converted word
+ * @return true if the word can be checked, false otherwise
+ */
+auto Dictionary::input_word_to_internal(const string& in,
+                                        wstring& wide_out) const -> bool
+{
+	auto ok_enc = external_to_internal_encoding(in, wide_out);
+	if (unlikely(wide_out.size() > 180)) {
+		wide_out.resize(180);
+		wide_out.shrink_to_fit();
+		return false;
+	}
+	return ok_enc;
+}
+
+Dictionary::Dictionary() : external_locale_known_utf8(true) {}
+
+/**
+ * @brief Create a dictionary from opened files as iostreams
+ *
+ * Prefer using load_from_path(). Use this if you have a specific use case,
+ * like when .aff and .dic are in-memory buffers istringstream.
+ *
+ * @param aff The iostream of the .aff file
+ * @param dic The iostream of the .dic file
+ * @return Dictionary object
+ * @throws Dictionary_Loading_Error on error
+ */
+auto Dictionary::load_from_aff_dic(std::istream& aff, std::istream& dic)
+    -> Dictionary
+{
+	return Dictionary(aff, dic);
+}
+
+/**
+ * @brief Create a dictionary from files
+ * @param file_path_without_extension path *without* extensions (without .dic or
+ * .aff)
+ * @return Dictionary object
+ * @throws Dictionary_Loading_Error on error
+ */
+auto Dictionary::load_from_path(const std::string& file_path_without_extension)
+    -> Dictionary
+{
+	auto path = file_path_without_extension;
+	path += ".aff";
+	std::ifstream aff_file(path);
+	if (aff_file.fail()) {
+		auto err = "Aff file " + path + " not found";
+		throw Dictionary_Loading_Error(err);
+	}
+	path.replace(path.size() - 3, 3, "dic");
+	std::ifstream dic_file(path);
+	if (dic_file.fail()) {
+		auto err = "Dic file " + path + " not found";
+		throw Dictionary_Loading_Error(err);
+	}
+	return load_from_aff_dic(aff_file, dic_file);
+}
+
+/**
+ * @brief Sets external (public API) encoding
+ *
+ * By external encoding we mean the encoding of the strings that you are going
+ * to pass to other functions like spell() and suggest(). This function should
+ * be used rarely, as the default external encoding is UTF-8.
+ *
+ * This encoding should not be misunderstood with the internal encoding or with
+ * the encoding of the dictionary files (.dic and .aff). It can be different
+ * than any of them.
+ *
+ * The locale must contain std::codecvt<wchar_t, char, mbstate_t> facet that can
+ * convert the strings from the external locale to UTF-32 on non-Windows
+ * platforms, and to UTF-16 on Windows.
+ *
+ * @param loc locale object with valid codecvt<wchar_t, char, mbstate_t>
+ */
+auto Dictionary::imbue(const locale& loc) -> void
+{
+	external_locale = loc;
+	external_locale_known_utf8 = is_locale_known_utf8(external_locale);
+}
+
+/**
+ * @brief Sets external (public API) encoding to UTF-8
+ *
+ * Call this only if you used imbue() and want to revert it to UTF-8.
  */
 auto Dictionary::imbue_utf8() -> void { external_locale_known_utf8 = true; }
 
+/**
+ * @brief Releases memory under memory pressure without unloading
+ *
+ * The per-thread buffers and the caches are shared by all dictionaries, so
+ * trimming them affects the whole process. Each thread frees its buffers on
+ * its next call into the library, and each cache is dropped on its next use
+ * and rebuilt on demand.
+ *
+ * Trim_Level::ALL rebuilds the word list of this dictionary, so unlike the
+ * lower levels it must not run concurrently with other calls on the same
+ * object.
+ *
+ * @param level what to release
+ */
+auto Dictionary::trim(Trim_Level level) -> void
+{
+	++trim_scratch_gen;
+	if (level >= Trim_Level::CACHES)
+		++trim_cache_gen;
+	if (level == Trim_Level::ALL)
+		words.shrink_to_fit();
+}
+
 /**
  * @brief Checks if a given word is correct
  * @param word any word
@@ -2774,16 +3858,146 @@ auto Dictionary::imbue_utf8() -> void { external_locale_known_utf8 = true; }
  */
 auto Dictionary::spell(const std::string& word) const -> bool
 {
-	auto static thread_local wide_word = wstring();
-	auto ok_enc = external_to_internal_encoding(word, wide_word);
-	if (unlikely(wide_word.size() > 180)) {
-		wide_word.resize(180);
-		wide_word.shrink_to_fit();
+	auto work = Spell_Work();
+	return spell(word, work);
+}
+
+/**
+ * @brief Checks if a given word is correct and reports the work done
+ *
+ * The work is limited, see set_spell_limits().
+ *
+ * @param word any word
+ * @param[out] work the lookups and splits done for the word
+ * @return true if correct, false otherwise or if a limit was reached
+ */
+auto Dictionary::spell(const std::string& word, Spell_Work& work) const
+    -> bool
+{
+	work = {};
+	auto& wide_word = get_thread_scratch().wide_word;
+	if (unlikely(!input_word_to_internal(word, wide_word)))
 		return false;
-	}
-	if (unlikely(!ok_enc))
+	return spell_priv_limited(wide_word, max_spell_probes,
+	                          max_spell_splits, work);
+}
+
+/**
+ * @brief Checks a word cheaply and approximately
+ *
+ * Only looks up the word as it is and with one suffix stripped. Meant for
+ * statistics over many words like identify_language(), not for spelling.
+ *
+ * @param word any word
+ * @return true if the word is found
+ */
+auto Dictionary::spell_quick(const std::string& word) const -> bool
+{
+	auto& wide_word = get_thread_scratch().wide_word;
+	if (unlikely(!input_word_to_internal(word, wide_word)))
 		return false;
-	return spell_priv(wide_word);
+	return Dict_Base::spell_quick(wide_word);
+}
+
+/**
+ * @brief Sets the limits of the work of spell()
+ *
+ * Spell checking of a word can try many affixes, casings, compound and BREAK
+ * splits, in the worst case exponentially many in the length of the word.
+ * spell() gives up and returns false when it reaches one of these limits.
+ * The defaults are DEFAULT_MAX_SPELL_PROBES and DEFAULT_MAX_SPELL_SPLITS.
+ *
+ * @param max_probes limit of the lookups in the word list
+ * @param max_splits limit of the tried splits of the word
+ */
+auto Dictionary::set_spell_limits(size_t max_probes, size_t max_splits)
+    -> void
+{
+	max_spell_probes = max_probes;
+	max_spell_splits = max_splits;
+}
+
+/**
+ * @brief Sets the hot tier, copies of the most used words kept compactly
+ *
+ * The words from the word list that are found while checking the sample
+ * are ranked by how many times they are found, ties by first appearance.
+ * The top of them is copied to a small table that spell() looks up before
+ * the big word list. The sample can be a list of frequent words, most
+ * frequent first, or a representative text split into words. The results
+ * of spell() do not change, only its speed.
+ *
+ * Must not be called concurrently with any other function of this object.
+ *
+ * @param sample words to check, most important first
+ * @param max_entries maximal number of copied entries, 0 removes the tier
+ */
+auto Dictionary::set_hot_words(const std::vector<std::string>& sample,
+                               size_t max_entries) -> void
+{
+	hot_words.clear();
+	if (max_entries == 0)
+		return;
+	auto recorder = Hot_Word_Recorder();
+	auto& wide_word = get_thread_scratch().wide_word;
+	auto work = Spell_Work();
+	for (auto& word : sample)
+		if (input_word_to_internal(word, wide_word))
+			spell_priv_limited(wide_word, max_spell_probes,
+			                   max_spell_splits, work, &recorder);
+	auto& counts = recorder.counts;
+	stable_sort(begin(counts), end(counts),
+	            [](auto& a, auto& b) { return a.second > b.second; });
+	auto keys = vector<wstring>();
+	keys.reserve(counts.size());
+	for (auto& c : counts)
+		keys.push_back(move(c.first));
+	hot_words.assign(words, keys, max_entries);
+}
+
+/**
+ * @brief Sets the hot tier like set_hot_words(), cached in a sidecar file
+ *
+ * The hot words are stored in a cache file next to the dictionary, keyed
+ * by a hash of the loaded .aff and .dic content, the sample and
+ * @p max_entries. The files are not read again.
+ * When the cache is valid, the sample is not checked. Otherwise the hot
+ * tier is built from the sample and the cache is replaced atomically. If
+ * the cache can not be written, e.g. in a read-only directory, the hot tier
+ * is still set.
+ *
+ * Must not be called concurrently with any other function of this object.
+ *
+ * @param file_path_without_extension the path given to load_from_path(),
+ * it only gives the default location of the cache
+ * @param sample words to check, most important first
+ * @param max_entries maximal number of copied entries
+ * @param cache_path the cache file, by default the dictionary path with
+ * the extension .nuspell-cache
+ * @return true if the cache was valid
+ */
+auto Dictionary::set_hot_words_cached(
+    const std::string& file_path_without_extension,
+    const std::vector<std::string>& sample, size_t max_entries,
+    std::string cache_path) -> bool
+{
+	auto& base = file_path_without_extension;
+	if (cache_path.empty())
+		cache_path = base + ".nuspell-cache";
+	auto h = content_hash;
+	for (auto& word : sample)
+		h = hash_bytes(word, h);
+	h = hash_bytes({}, h ^ max_entries);
+
+	auto keys = vector<wstring>();
+	if (read_sidecar(cache_path, h, keys)) {
+		hot_words.assign(words, keys, max_entries);
+		return true;
+	}
+	set_hot_words(sample, max_entries);
+	hot_words.keys(keys);
+	write_sidecar(cache_path, h, keys);
+	return false;
 }
 
 /**
@@ -2794,19 +4008,295 @@ auto Dictionary::spell(const std::string& word) const -> bool
 auto Dictionary::suggest(const std::string& word,
                          std::vector<std::string>& out) const -> void
 {
-	auto static thread_local wide_word = wstring();
-	auto static thread_local wide_list = List_WStrings();
+	auto& scratch = get_thread_scratch();
+	auto& wide_word = scratch.wide_word;
+	auto& wide_list = scratch.wide_list;
+	suggest_with_buffers(word, out, wide_word, wide_list);
+}
+
+/**
+ * @brief Suggests correct words into a reusable buffer
+ *
+ * Unlike the overload with vector, this one does not allocate a string per
+ * suggestion. Reuse the same @p out for many calls.
+ *
+ * @param[in] word incorrect word
+ * @param[out] out cleared and populated with the suggestions
+ */
+auto Dictionary::suggest(const std::string& word, Suggestion_List& out) const
+    -> void
+{
+	auto& scratch = get_thread_scratch();
+	out.clear();
+	if (!suggest_wide(word, scratch.wide_word, scratch.wide_list))
+		return;
+	for (auto& w : scratch.wide_list) {
+		internal_to_external_encoding(w, scratch.narrow_word);
+		out.push_back(scratch.narrow_word);
+	}
+}
+
+auto Dictionary::suggest_wide(const std::string& word, std::wstring& wide_word,
+                              List_WStrings& wide_list,
+                              const Cancellation_Token* token,
+                              Executor* executor) const -> bool
+{
+	if (unlikely(!input_word_to_internal(word, wide_word)))
+		return false;
+	wide_list.clear();
+	suggest_priv(wide_word, wide_list, token, executor);
+	return true;
+}
+
+auto Dictionary::suggest_with_buffers(const std::string& word,
+                                      std::vector<std::string>& out,
+                                      std::wstring& wide_word,
+                                      List_WStrings& wide_list,
+                                      const Cancellation_Token* token,
+                                      Executor* executor) const -> void
+{
+	if (!suggest_wide(word, wide_word, wide_list, token, executor))
+		return;
+
+	auto narrow_list = List_Strings(move(out));
+	narrow_list.clear();
+	for (auto& w : wide_list) {
+		auto& o = narrow_list.emplace_back();
+		internal_to_external_encoding(w, o);
+	}
+	out = narrow_list.extract_sequence();
+}
+
+/**
+ * @brief Suggests correct words asynchronously, delivering them to a callback
+ *
+ * The work runs on the executor and this function returns immediately. The
+ * callback is called exactly once, on the thread of the executor. If the
+ * token gets cancelled, the remaining suggestion generators are skipped and
+ * the callback receives the suggestions found until then.
+ *
+ * If the search fails, e.g. with bad_alloc, @p on_error is called with the
+ * exception instead of @p callback. Exactly one of the two is called, and no
+ * exception is thrown out of the task to the executor.
+ *
+ * The dictionary must not be destroyed before the callback is called, and
+ * the callbacks should not throw.
+ *
+ * @param word incorrect word
+ * @param callback function that receives the suggestions
+ * @param on_error function that receives the error if the search fails
+ * @param executor executor on which to run the work
+ * @param token token that can cancel the work
+ * @throws std::invalid_argument if @p callback or @p on_error is empty
+ */
+auto Dictionary::suggest_async(const std::string& word,
+                               Suggest_Callback callback,
+                               Error_Callback on_error, Executor& executor,
+                               const Cancellation_Token& token) const -> void
+{
+	if (!callback || !on_error)
+		throw invalid_argument("suggest_async() needs both callbacks");
+	executor.execute([this, word, callback = move(callback), token,
+	                  on_error = move(on_error), ex = &executor] {
+		auto sugs = vector<string>();
+		try {
+			auto& scratch = get_thread_scratch();
+			suggest_with_buffers(word, sugs, scratch.wide_word,
+			                     scratch.wide_list, &token, ex);
+		}
+		catch (...) {
+			on_error(current_exception());
+			return;
+		}
+		callback(sugs);
+	});
+}
+
+/**
+ * @brief Suggests correct words asynchronously, delivering them to a future
+ *
+ * Same as the callback overload, but the suggestions are retrieved from the
+ * returned future. If the search fails, the future holds the exception.
+ *
+ * @param word incorrect word
+ * @param executor executor on which to run the work
+ * @param token token that can cancel the work
+ * @return future that becomes ready when the suggestions are found
+ */
+auto Dictionary::suggest_async(const std::string& word, Executor& executor,
+                               const Cancellation_Token& token) const
+    -> std::future<std::vector<std::string>>
+{
+	auto promise = make_shared<std::promise<vector<string>>>();
+	auto ret = promise->get_future();
+	suggest_async(
+	    word,
+	    [promise](vector<string>& sugs) { promise->set_value(move(sugs)); },
+	    [promise](exception_ptr e) { promise->set_exception(e); },
+	    executor, token);
+	return ret;
+}
+
+/**
+ * @brief Suggests correct words for many incorrect words in parallel
+ *
+ * The words are distributed among the threads of the executor and the calling
+ * thread, each of them with its own buffers. Suggestions for identical words
+ * are calculated only once. The callback is called once for every index of
+ * @p words, as soon as the suggestions for that word are ready, in no
+ * particular order. Calls to the callback are serialized, it is never called
+ * concurrently.
+ *
+ * If the callback throws, the remaining words are not processed and the
+ * exception is rethrown from this function. If the token gets cancelled, the
+ * remaining words are not processed and the function returns normally.
+ *
+ * The function does not wait for tasks of the executor that have not started
+ * yet, so it is safe to call it from a task running on the same executor.
+ *
+ * @param words incorrect words
+ * @param callback function that receives the index of the word and the
+ * suggestions for it
+ * @param executor executor on which to run the work in parallel
+ * @param token token that can cancel the work
+ */
+auto Dictionary::suggest_batch(const std::vector<std::string>& words,
+                               const Batch_Callback& callback,
+                               Executor& executor,
+                               const Cancellation_Token& token) const -> void
+{
+	// group the indexes of identical words
+	auto order = vector<size_t>(words.size());
+	for (size_t i = 0; i != order.size(); ++i)
+		order[i] = i;
+	stable_sort(begin(order), end(order),
+	            [&](size_t a, size_t b) { return words[a] < words[b]; });
+	auto groups = vector<size_t>(); // begin of each group in order
+	for (size_t i = 0; i != order.size(); ++i)
+		if (i == 0 || words[order[i]] != words[order[i - 1]])
+			groups.push_back(i);
+	auto num_groups = groups.size();
+	groups.push_back(order.size());
+
+	// The state outlives this function if some task starts late. Such
+	// task sees that no group is left and does not touch anything else.
+	struct Batch_State {
+		mutex mtx;
+		condition_variable cv;
+		size_t next_group = 0;
+		size_t num_active = 0;
+		bool stop = false;
+		exception_ptr error;
+	};
+	auto state = make_shared<Batch_State>();
+	auto work = [&, state, num_groups, token]() {
+		auto wide_word = wstring();
+		auto wide_list = List_WStrings();
+		auto sugs = vector<string>();
+		auto lock = unique_lock<mutex>(state->mtx);
+		for (;;) {
+			if (token.is_cancelled())
+				state->stop = true;
+			if (state->stop || state->next_group == num_groups)
+				return;
+			auto g = state->next_group++;
+			++state->num_active;
+			lock.unlock();
+
+			auto first = begin(order) + groups[g];
+			auto last = begin(order) + groups[g + 1];
+			sugs.clear();
+			try {
+				suggest_with_buffers(words[*first], sugs,
+				                     wide_word, wide_list,
+				                     &token, &executor);
+				lock.lock();
+				if (token.is_cancelled())
+					state->stop = true;
+				if (!state->stop)
+					for (auto it = first; it != last; ++it)
+						callback(*it, sugs);
+			}
+			catch (...) {
+				if (!lock)
+					lock.lock();
+				if (!state->error)
+					state->error = current_exception();
+				state->stop = true;
+			}
+			if (--state->num_active == 0)
+				state->cv.notify_all();
+		}
+	};
+	auto num_tasks = min(executor.concurrency(), num_groups);
+	for (size_t i = 1; i < num_tasks; ++i)
+		executor.execute(work);
+	work();
+	auto lock = unique_lock<mutex>(state->mtx);
+	state->cv.wait(lock, [&] {
+		return (state->stop || state->next_group == num_groups) &&
+		       state->num_active == 0;
+	});
+	if (state->error)
+		rethrow_exception(state->error);
+}
+
+/**
+ * @brief Finds the roots (stems) of a given word
+ *
+ * All valid decompositions of the word into a dictionary root and up to two
+ * affixes are considered, so one word can have several roots. Compound words
+ * are not decomposed.
+ *
+ * @param[in] word any word
+ * @param[out] out this object will be populated with the roots
+ */
+auto Dictionary::stem(const std::string& word,
+                      std::vector<std::string>& out) const -> void
+{
+	auto& scratch = get_thread_scratch();
+	auto& wide_word = scratch.wide_word;
+	auto& wide_list = scratch.wide_list;
 
-	auto ok_enc = external_to_internal_encoding(word, wide_word);
-	if (unlikely(wide_word.size() > 180)) {
-		wide_word.resize(180);
-		wide_word.shrink_to_fit();
+	out.clear();
+	if (unlikely(!input_word_to_internal(word, wide_word)))
 		return;
+	wide_list.clear();
+	stem_priv(wide_word, wide_list);
+
+	auto narrow_list = List_Strings(move(out));
+	narrow_list.clear();
+	for (auto& w : wide_list) {
+		auto& o = narrow_list.emplace_back();
+		internal_to_external_encoding(w, o);
 	}
-	if (unlikely(!ok_enc))
+	out = narrow_list.extract_sequence();
+}
+
+/**
+ * @brief Morphological analysis of a given word
+ *
+ * Each analysis is a string of morphological fields separated by space. It
+ * starts with the field "st:" containing the root, followed by the fields of
+ * the affixes and of the root as written in the .aff and .dic files. There is
+ * one analysis for each decomposition of the word into a root and up to two
+ * affixes.
+ *
+ * @param[in] word any word
+ * @param[out] out this object will be populated with the analyses
+ */
+auto Dictionary::analyze(const std::string& word,
+                         std::vector<std::string>& out) const -> void
+{
+	auto& scratch = get_thread_scratch();
+	auto& wide_word = scratch.wide_word;
+	auto& wide_list = scratch.wide_list;
+
+	out.clear();
+	if (unlikely(!input_word_to_internal(word, wide_word)))
 		return;
 	wide_list.clear();
-	suggest_priv(wide_word, wide_list);
+	analyze_priv(wide_word, wide_list);
 
 	auto narrow_list = List_Strings(move(out));
 	narrow_list.clear();
@@ -2816,4 +4306,403 @@ auto Dictionary::suggest(const std::string& word,
 	}
 	out = narrow_list.extract_sequence();
 }
+
+/**
+ * @brief Splits identifier into subwords
+ *
+ * Boundaries are placed at underscores, digits and other ASCII punctuation,
+ * which are not part of any subword, between a lowercase and an uppercase
+ * letter, and before the last letter of an uppercase run that is followed by
+ * lowercase letters, e.g. HTTPResponse gives HTTP and Response. Only ASCII
+ * letters are classified by case, other bytes are treated as lowercase
+ * letters. Subwords of a single byte are not emitted.
+ *
+ * @param[in] identifier identifier
+ * @param[out] out subwords
+ */
+auto Identifier_Checker::split(std::string_view identifier,
+                               std::vector<Subword>& out) -> void
+{
+	enum Char_Class { OTHER, LOWER, UPPER };
+	auto classify = [](char c) {
+		if (c >= 'a' && c <= 'z')
+			return LOWER;
+		if (c >= 'A' && c <= 'Z')
+			return UPPER;
+		if (static_cast<unsigned char>(c) >= 0x80)
+			return LOWER;
+		return OTHER;
+	};
+	auto& id = identifier;
+	auto n = id.size();
+	out.clear();
+	for (size_t i = 0; i != n;) {
+		if (classify(id[i]) == OTHER) {
+			++i;
+			continue;
+		}
+		auto j = i;
+		while (j != n && classify(id[j]) == UPPER)
+			++j;
+		if (j != n && classify(id[j]) == LOWER) {
+			if (j - i > 1) {
+				if (j - 1 - i > 1)
+					out.push_back({i, j - 1 - i});
+				i = j - 1;
+			}
+			while (j != n && classify(id[j]) == LOWER)
+				++j;
+		}
+		if (j - i > 1)
+			out.push_back({i, j - i});
+		i = j;
+	}
+}
+
+Identifier_Checker::Identifier_Checker(const Dictionary& dic)
+    : dic(dic), cache_generation(trim_cache_gen)
+{
+}
+
+Identifier_Checker::~Identifier_Checker() { release_cache(cache_bytes); }
+
+auto Identifier_Checker::clear_cache() -> void
+{
+	cache = {};
+	release_cache(cache_bytes);
+	cache_bytes = 0;
+}
+
+/**
+ * @brief Checks if a subword is correct, using the cache
+ *
+ * The cache counts towards the global cache budget. When the budget is
+ * exhausted, new verdicts are not cached.
+ *
+ * @param subword subword
+ * @return true if correct, false otherwise
+ */
+auto Identifier_Checker::spell_subword(std::string_view subword) -> bool
+{
+	auto gen = trim_cache_gen.load(memory_order_relaxed);
+	if (unlikely(cache_generation != gen)) {
+		clear_cache();
+		cache_generation = gen;
+	}
+	key.assign(subword);
+	auto it = cache.find(key);
+	if (it != end(cache))
+		return it->second;
+	auto correct = dic.spell(key);
+	// node with the string, next pointer, hash and bucket
+	auto cost = sizeof(decltype(cache)::value_type) + key.size() +
+	            3 * sizeof(void*);
+	if (try_charge_cache(cost)) {
+		cache.emplace(key, correct);
+		cache_bytes += cost;
+	}
+	return correct;
+}
+
+/**
+ * @brief Checks an identifier
+ * @param[in] identifier identifier
+ * @param[out] misspelled misspelled subwords, offsets are in bytes
+ * @return true if all subwords are correct, false otherwise
+ */
+auto Identifier_Checker::check(std::string_view identifier,
+                               std::vector<Subword>& misspelled) -> bool
+{
+	misspelled.clear();
+	split(identifier, subwords);
+	for (auto& sw : subwords)
+		if (!spell_subword(identifier.substr(sw.offset, sw.length)))
+			misspelled.push_back(sw);
+	return misspelled.empty();
+}
+
+inline namespace v3 {
+namespace {
+/**
+ * @brief Splits text into tokens of letters, evenly sampled
+ *
+ * Tokens are runs of ASCII letters and non-ASCII bytes, with apostrophes
+ * between them. Tokens of one byte are skipped.
+ */
+auto sample_tokens(string_view text, size_t max_tokens, vector<string>& out)
+{
+	auto is_letter = [](char c) {
+		auto lower = char(c | 0x20);
+		return (c & 0x80) != 0 || (lower >= 'a' && lower <= 'z');
+	};
+	auto tokens = vector<string_view>();
+	for (size_t i = 0; i != text.size();) {
+		if (!is_letter(text[i])) {
+			++i;
+			continue;
+		}
+		auto j = i + 1;
+		while (j != text.size() &&
+		       (is_letter(text[j]) ||
+		        (text[j] == '\'' && j + 1 != text.size() &&
+		         is_letter(text[j + 1]))))
+			++j;
+		if (j - i > 1)
+			tokens.push_back(text.substr(i, j - i));
+		i = j;
+	}
+	out.clear();
+	auto n = min(tokens.size(), max_tokens);
+	for (size_t k = 0; k != n; ++k)
+		out.emplace_back(tokens[k * tokens.size() / n]);
+}
+} // namespace
+
+/**
+ * @brief Estimates which dictionary matches the language of a text
+ *
+ * Up to @p max_tokens words, evenly sampled from the text, are checked with
+ * Dictionary::spell_quick() by each dictionary, in parallel on the executor.
+ * The words are checked in chunks, taken from the dictionaries in turn.
+ * Before each chunk, a dictionary stops early if another one that has
+ * checked at least a minimal number of words leads it by a clear margin of
+ * the hit rate, and the leader stops when all others have stopped. If no
+ * dictionary accepts any word, there is no best one.
+ *
+ * @param text text sample in the encoding of the dictionaries
+ * @param dictionaries candidate dictionaries, not null
+ * @param executor where to run the checks
+ * @param max_tokens limit of sampled words
+ * @return hit counts per dictionary and the best one
+ */
+auto identify_language(std::string_view text,
+                       const std::vector<const Dictionary*>& dictionaries,
+                       Executor& executor, size_t max_tokens) -> Language_Guess
+{
+	constexpr size_t chunk = 32;
+	constexpr size_t min_tokens = 64;
+	constexpr double margin = 0.25;
+
+	auto num_dics = dictionaries.size();
+	auto guess = Language_Guess();
+	guess.checked.resize(num_dics);
+	guess.hits.resize(num_dics);
+	auto tokens = vector<string>();
+	sample_tokens(text, max_tokens, tokens);
+	if (num_dics == 0 || tokens.empty())
+		return guess;
+
+	struct Progress {
+		size_t checked = 0;
+		size_t hits = 0;
+		bool busy = false;
+		bool stopped = false;
+	};
+	// As in suggest_batch(), a task that starts late finds nothing left.
+	struct Identify_State {
+		mutex mtx;
+		condition_variable cv;
+		vector<Progress> progress;
+		size_t next_dic = 0;
+		size_t num_active = 0;
+		size_t num_stopped = 0;
+		exception_ptr error;
+	};
+	auto state = make_shared<Identify_State>();
+	state->progress.resize(num_dics);
+
+	// returns true if dictionary i should stop, state->mtx is locked
+	auto should_stop = [&, num_dics](size_t i) {
+		auto& p = state->progress;
+		if (p[i].checked == tokens.size())
+			return true;
+		if (p[i].checked < min_tokens)
+			return false;
+		auto rate = double(p[i].hits) / p[i].checked;
+		auto leading = true;
+		for (size_t j = 0; j != num_dics; ++j) {
+			if (j == i || p[j].checked < min_tokens)
+				continue;
+			auto other = double(p[j].hits) / p[j].checked;
+			if (other > rate + margin)
+				return true;
+			if (other >= rate)
+				leading = false;
+		}
+		return leading && state->num_stopped + 1 == num_dics;
+	};
+	// Picks the next dictionary round-robin, so all of them advance
+	// together and the early stop works with any concurrency. Returns
+	// num_dics if all the remaining ones are checked by other tasks.
+	auto pick_dic = [&, num_dics]() {
+		for (size_t k = 0; k != num_dics; ++k) {
+			auto i = (state->next_dic + k) % num_dics;
+			auto& p = state->progress[i];
+			if (p.busy || p.stopped)
+				continue;
+			if (should_stop(i)) {
+				p.stopped = true;
+				++state->num_stopped;
+				continue;
+			}
+			state->next_dic = (i + 1) % num_dics;
+			return i;
+		}
+		return num_dics;
+	};
+	// checks the next chunk with dictionary i, unlocks meanwhile
+	auto check_chunk = [&](size_t i, unique_lock<mutex>& lock) {
+		auto& p = state->progress[i];
+		auto first = p.checked;
+		auto last = min(first + chunk, tokens.size());
+		p.busy = true;
+		lock.unlock();
+		auto hits = size_t(0);
+		try {
+			for (auto k = first; k != last; ++k)
+				hits += dictionaries[i]->spell_quick(tokens[k]);
+		}
+		catch (...) {
+			lock.lock();
+			p.busy = false;
+			throw;
+		}
+		lock.lock();
+		p.busy = false;
+		p.checked = last;
+		p.hits += hits;
+	};
+	auto work = [&, state, num_dics]() {
+		auto lock = unique_lock<mutex>(state->mtx);
+		if (state->error || state->num_stopped == num_dics)
+			return;
+		++state->num_active;
+		try {
+			for (;;) {
+				if (state->error)
+					break;
+				auto i = pick_dic();
+				if (i == num_dics)
+					break;
+				check_chunk(i, lock);
+			}
+		}
+		catch (...) {
+			if (!state->error)
+				state->error = current_exception();
+		}
+		if (--state->num_active == 0)
+			state->cv.notify_all();
+	};
+	auto num_tasks = min(executor.concurrency(), num_dics);
+	for (size_t i = 1; i < num_tasks; ++i)
+		executor.execute(work);
+	work();
+	auto lock = unique_lock<mutex>(state->mtx);
+	state->cv.wait(lock, [&] {
+		return (state->error || state->num_stopped == num_dics) &&
+		       state->num_active == 0;
+	});
+	if (state->error)
+		rethrow_exception(state->error);
+	auto best_rate = 0.0; // no hits at all is no match
+	for (size_t i = 0; i != num_dics; ++i) {
+		auto& p = state->progress[i];
+		guess.checked[i] = p.checked;
+		guess.hits[i] = p.hits;
+		if (guess.hit_rate(i) > best_rate) {
+			best_rate = guess.hit_rate(i);
+			guess.best = i;
+		}
+	}
+	return guess;
+}
+
+/**
+ * @brief Loads many dictionaries in parallel
+ *
+ * Names that contain a path separator are paths without extension, other
+ * names are looked up with the finder. An error with one dictionary does
+ * not stop loading the others, it is reported in its result.
+ *
+ * Loading needs memory of a few times the size of the dictionary, so with
+ * large dictionaries the peak memory is bounded by limiting how many of
+ * them are loaded at the same time.
+ *
+ * @param names dictionary names or paths without extension
+ * @param finder finder with already searched dictionaries
+ * @param executor where to run the loading
+ * @param max_concurrent limit of dictionaries loaded at the same time, 0
+ * means the concurrency of the executor
+ * @return one result per name, in the same order
+ */
+auto load_many(const std::vector<std::string>& names, const Finder& finder,
+               Executor& executor, size_t max_concurrent)
+    -> std::vector<Load_Result>
+{
+#ifdef _WIN32
+	auto const PATH_SEPS = "\\/";
+#else
+	auto const PATH_SEPS = '/';
+#endif
+	auto num_dics = names.size();
+	auto results = vector<Load_Result>(num_dics);
+	for (size_t i = 0; i != num_dics; ++i) {
+		auto& name = names[i];
+		results[i].name = name;
+		if (name.find_first_of(PATH_SEPS) != name.npos)
+			results[i].path = name;
+		else
+			results[i].path = finder.get_dictionary_path(name);
+	}
+
+	// As in suggest_batch(), a task that starts late finds nothing left.
+	struct Load_State {
+		mutex mtx;
+		condition_variable cv;
+		size_t next_dic = 0;
+		size_t num_active = 0;
+	};
+	auto state = make_shared<Load_State>();
+	auto work = [&, state, num_dics]() {
+		auto lock = unique_lock<mutex>(state->mtx);
+		while (state->next_dic != num_dics) {
+			auto& res = results[state->next_dic++];
+			++state->num_active;
+			lock.unlock();
+			try {
+				if (res.path.empty())
+					throw Dictionary_Loading_Error(
+					    "Dictionary " + res.name +
+					    " not found");
+				res.dictionary =
+				    Dictionary::load_from_path(res.path);
+			}
+			catch (const std::exception& e) {
+				res.error = e.what();
+			}
+			catch (...) {
+				// the other slots and the waiting caller must
+				// not be affected by an exception of any type
+				res.error = "Unknown error while loading " +
+				            res.name;
+			}
+			lock.lock();
+			if (--state->num_active == 0)
+				state->cv.notify_all();
+		}
+	};
+	if (max_concurrent == 0)
+		max_concurrent = executor.concurrency();
+	auto num_tasks = min(max(max_concurrent, size_t(1)), num_dics);
+	for (size_t i = 1; i < num_tasks; ++i)
+		executor.execute(work);
+	work();
+	auto lock = unique_lock<mutex>(state->mtx);
+	state->cv.wait(lock, [&] {
+		return state->next_dic == num_dics && state->num_active == 0;
+	});
+	return results;
+}
+} // namespace v3
 } // namespace nuspell
@@ -25,8 +25,13 @@
 #define NUSPELL_DICTIONARY_HXX
 
 #include "aff_data.hxx"
+#include "executor.hxx"
+#include "finder.hxx"
 
+#include <functional>
+#include <future>
 #include <locale>
+#include <optional>
 
 namespace nuspell {
 inline namespace v3 {
@@ -46,10 +51,23 @@ struct Affixing_Result_Base {
 	auto operator-> () const { return root_word; }
 };
 
-template <class T1 = void, class T2 = void>
+template <class T1 = void, class T2 = void, class T3 = void>
 struct Affixing_Result : Affixing_Result_Base {
 	const T1* a = {};
 	const T2* b = {};
+	const T3* c = {};
+
+	Affixing_Result() = default;
+	Affixing_Result(Word_List::const_reference r, const T1& a, const T2& b,
+	                const T3& c)
+	    : Affixing_Result_Base{&r}, a{&a}, b{&b}, c{&c}
+	{
+	}
+};
+template <class T1, class T2>
+struct Affixing_Result<T1, T2, void> : Affixing_Result_Base {
+	const T1* a = {};
+	const T2* b = {};
 
 	Affixing_Result() = default;
 	Affixing_Result(Word_List::const_reference r, const T1& a, const T2& b)
@@ -58,7 +76,7 @@ struct Affixing_Result : Affixing_Result_Base {
 	}
 };
 template <class T1>
-struct Affixing_Result<T1, void> : Affixing_Result_Base {
+struct Affixing_Result<T1, void, void> : Affixing_Result_Base {
 	const T1* a = {};
 
 	Affixing_Result() = default;
@@ -69,7 +87,7 @@ struct Affixing_Result<T1, void> : Affixing_Result_Base {
 };
 
 template <>
-struct Affixing_Result<void, void> : Affixing_Result_Base {
+struct Affixing_Result<void, void, void> : Affixing_Result_Base {
 	Affixing_Result() = default;
 	Affixing_Result(Word_List::const_reference r) : Affixing_Result_Base{&r}
 	{
@@ -86,6 +104,18 @@ struct Compounding_Result {
 	auto operator-> () const { return word_entry; }
 };
 
+/**
+ * @brief Work done by one call of Dictionary::spell()
+ */
+struct Spell_Work {
+	size_t probes = 0; /**< lookups in the word list */
+	size_t splits = 0; /**< tried splits by compounding and BREAK */
+	bool exhausted = false; /**< a limit was reached, word rejected */
+};
+
+struct Segment_Cache;
+struct Hot_Word_Recorder;
+
 struct Dict_Base : public Aff_Data {
 
 	enum Hidden_Homonym : bool {
@@ -94,6 +124,10 @@ struct Dict_Base : public Aff_Data {
 	};
 
 	auto spell_priv(std::wstring& s) const -> bool;
+	auto spell_priv_limited(std::wstring& s, size_t max_probes,
+	                        size_t max_splits, Spell_Work& work,
+	                        Hot_Word_Recorder* recorder = nullptr) const
+	    -> bool;
 	auto spell_break(std::wstring& s, size_t depth = 0) const -> bool;
 	auto spell_casing(std::wstring& s) const -> const Flag_Set*;
 	auto spell_casing_upper(std::wstring& s) const -> const Flag_Set*;
@@ -107,6 +141,7 @@ struct Dict_Base : public Aff_Data {
 	auto check_simple_word(std::wstring& word,
 	                       Hidden_Homonym skip_hidden_homonym = {}) const
 	    -> const Flag_Set*;
+	auto spell_quick(std::wstring& s) const -> bool;
 
 	template <Affixing_Mode m>
 	auto affix_NOT_valid(const Prefix<wchar_t>& a) const;
@@ -119,6 +154,22 @@ struct Dict_Base : public Aff_Data {
 	template <Affixing_Mode m>
 	auto is_valid_inside_compound(const Flag_Set& flags) const;
 
+	/**
+	 * @brief Enumerates all roots of a word with one prefix
+	 *
+	 * The functions for_each_* call the callback for every valid
+	 * decomposition, instead of stopping at the first one. The callback
+	 * gets the Affixing_Result and returns true to stop the enumeration.
+	 *
+	 * @param s derived word with affixes
+	 * @param cb callback
+	 * @return true if the callback stopped the enumeration
+	 */
+	template <Affixing_Mode m, class CallbackT>
+	auto for_each_prefix_only(std::wstring& s,
+	                          Hidden_Homonym skip_hidden_homonym,
+	                          CallbackT&& cb) const -> bool;
+
 	/**
 	 * @brief strip_prefix_only
 	 * @param s derived word with affixes
@@ -129,6 +180,11 @@ struct Dict_Base : public Aff_Data {
 	                       Hidden_Homonym skip_hidden_homonym = {}) const
 	    -> Affixing_Result<Prefix<wchar_t>>;
 
+	template <Affixing_Mode m, class CallbackT>
+	auto for_each_suffix_only(std::wstring& s,
+	                          Hidden_Homonym skip_hidden_homonym,
+	                          CallbackT&& cb) const -> bool;
+
 	/**
 	 * @brief strip_suffix_only
 	 * @param s derived word with affixes
@@ -179,6 +235,17 @@ struct Dict_Base : public Aff_Data {
 	                          Hidden_Homonym skip_hidden_homonym) const
 	    -> Affixing_Result<Prefix<wchar_t>, Suffix<wchar_t>>;
 
+	template <Affixing_Mode m, class CallbackT>
+	auto for_each_prefix_then_suffix_comm(std::wstring& word,
+	                                      Hidden_Homonym skip_hidden_homonym,
+	                                      CallbackT&& cb) const -> bool;
+
+	template <Affixing_Mode m, class CallbackT>
+	auto for_each_pfx_then_sfx_comm_2(const Prefix<wchar_t>& pe,
+	                                  std::wstring& word,
+	                                  Hidden_Homonym skip_hidden_homonym,
+	                                  CallbackT&& cb) const -> bool;
+
 	template <Affixing_Mode m = FULL_WORD>
 	auto strip_prefix_then_suffix_commutative(
 	    std::wstring& word, Hidden_Homonym skip_hidden_homonym = {}) const
@@ -190,6 +257,17 @@ struct Dict_Base : public Aff_Data {
 	                               Hidden_Homonym skip_hidden_homonym) const
 	    -> Affixing_Result<Suffix<wchar_t>, Prefix<wchar_t>>;
 
+	template <Affixing_Mode m, class CallbackT>
+	auto for_each_suffix_then_suffix(std::wstring& s,
+	                                 Hidden_Homonym skip_hidden_homonym,
+	                                 CallbackT&& cb) const -> bool;
+
+	template <Affixing_Mode m, class CallbackT>
+	auto for_each_sfx_then_sfx_2(const Suffix<wchar_t>& se1,
+	                             std::wstring& s,
+	                             Hidden_Homonym skip_hidden_homonym,
+	                             CallbackT&& cb) const -> bool;
+
 	template <Affixing_Mode m = FULL_WORD>
 	auto
 	strip_suffix_then_suffix(std::wstring& s,
@@ -201,6 +279,17 @@ struct Dict_Base : public Aff_Data {
 	                          Hidden_Homonym skip_hidden_homonym) const
 	    -> Affixing_Result<Suffix<wchar_t>, Suffix<wchar_t>>;
 
+	template <Affixing_Mode m, class CallbackT>
+	auto for_each_prefix_then_prefix(std::wstring& s,
+	                                 Hidden_Homonym skip_hidden_homonym,
+	                                 CallbackT&& cb) const -> bool;
+
+	template <Affixing_Mode m, class CallbackT>
+	auto for_each_pfx_then_pfx_2(const Prefix<wchar_t>& pe1,
+	                             std::wstring& s,
+	                             Hidden_Homonym skip_hidden_homonym,
+	                             CallbackT&& cb) const -> bool;
+
 	template <Affixing_Mode m = FULL_WORD>
 	auto
 	strip_prefix_then_prefix(std::wstring& s,
@@ -212,27 +301,53 @@ struct Dict_Base : public Aff_Data {
 	                          Hidden_Homonym skip_hidden_homonym) const
 	    -> Affixing_Result<Prefix<wchar_t>, Prefix<wchar_t>>;
 
+	template <Affixing_Mode m, class CallbackT>
+	auto for_each_prefix_then_2_suffixes(std::wstring& s,
+	                                     Hidden_Homonym skip_hidden_homonym,
+	                                     CallbackT&& cb) const -> bool;
+
 	template <Affixing_Mode m = FULL_WORD>
 	auto strip_prefix_then_2_suffixes(
 	    std::wstring& s, Hidden_Homonym skip_hidden_homonym = {}) const
-	    -> Affixing_Result<>;
+	    -> Affixing_Result<Suffix<wchar_t>, Suffix<wchar_t>,
+	                       Prefix<wchar_t>>;
+
+	template <Affixing_Mode m, class CallbackT>
+	auto for_each_pfx_2_sfx_3(const Prefix<wchar_t>& pe1,
+	                          const Suffix<wchar_t>& se1, std::wstring& s,
+	                          Hidden_Homonym skip_hidden_homonym,
+	                          CallbackT&& cb) const -> bool;
 
 	template <Affixing_Mode m>
 	auto strip_pfx_2_sfx_3(const Prefix<wchar_t>& pe1,
 	                       const Suffix<wchar_t>& se1, std::wstring& s,
 	                       Hidden_Homonym skip_hidden_homonym) const
-	    -> Affixing_Result<>;
+	    -> Affixing_Result<Suffix<wchar_t>, Suffix<wchar_t>,
+	                       Prefix<wchar_t>>;
+
+	template <Affixing_Mode m, class CallbackT>
+	auto for_each_suffix_prefix_suffix(std::wstring& s,
+	                                   Hidden_Homonym skip_hidden_homonym,
+	                                   CallbackT&& cb) const -> bool;
 
 	template <Affixing_Mode m = FULL_WORD>
 	auto strip_suffix_prefix_suffix(
 	    std::wstring& s, Hidden_Homonym skip_hidden_homonym = {}) const
-	    -> Affixing_Result<>;
+	    -> Affixing_Result<Suffix<wchar_t>, Prefix<wchar_t>,
+	                       Suffix<wchar_t>>;
+
+	template <Affixing_Mode m, class CallbackT>
+	auto for_each_s_p_s_3(const Suffix<wchar_t>& se1,
+	                      const Prefix<wchar_t>& pe1, std::wstring& word,
+	                      Hidden_Homonym skip_hidden_homonym,
+	                      CallbackT&& cb) const -> bool;
 
 	template <Affixing_Mode m>
 	auto strip_s_p_s_3(const Suffix<wchar_t>& se1,
 	                   const Prefix<wchar_t>& pe1, std::wstring& word,
 	                   Hidden_Homonym skip_hidden_homonym) const
-	    -> Affixing_Result<>;
+	    -> Affixing_Result<Suffix<wchar_t>, Prefix<wchar_t>,
+	                       Suffix<wchar_t>>;
 
 	template <Affixing_Mode m = FULL_WORD>
 	auto strip_2_suffixes_then_prefix(
@@ -245,27 +360,53 @@ struct Dict_Base : public Aff_Data {
 	                       Hidden_Homonym skip_hidden_homonym) const
 	    -> Affixing_Result<>;
 
+	template <Affixing_Mode m, class CallbackT>
+	auto for_each_suffix_then_2_prefixes(std::wstring& s,
+	                                     Hidden_Homonym skip_hidden_homonym,
+	                                     CallbackT&& cb) const -> bool;
+
 	template <Affixing_Mode m = FULL_WORD>
 	auto strip_suffix_then_2_prefixes(
 	    std::wstring& s, Hidden_Homonym skip_hidden_homonym = {}) const
-	    -> Affixing_Result<>;
+	    -> Affixing_Result<Prefix<wchar_t>, Prefix<wchar_t>,
+	                       Suffix<wchar_t>>;
+
+	template <Affixing_Mode m, class CallbackT>
+	auto for_each_sfx_2_pfx_3(const Suffix<wchar_t>& se1,
+	                          const Prefix<wchar_t>& pe1, std::wstring& s,
+	                          Hidden_Homonym skip_hidden_homonym,
+	                          CallbackT&& cb) const -> bool;
 
 	template <Affixing_Mode m>
 	auto strip_sfx_2_pfx_3(const Suffix<wchar_t>& se1,
 	                       const Prefix<wchar_t>& pe1, std::wstring& s,
 	                       Hidden_Homonym skip_hidden_homonym) const
-	    -> Affixing_Result<>;
+	    -> Affixing_Result<Prefix<wchar_t>, Prefix<wchar_t>,
+	                       Suffix<wchar_t>>;
+
+	template <Affixing_Mode m, class CallbackT>
+	auto for_each_prefix_suffix_prefix(std::wstring& word,
+	                                   Hidden_Homonym skip_hidden_homonym,
+	                                   CallbackT&& cb) const -> bool;
 
 	template <Affixing_Mode m = FULL_WORD>
 	auto strip_prefix_suffix_prefix(
 	    std::wstring& word, Hidden_Homonym skip_hidden_homonym = {}) const
-	    -> Affixing_Result<>;
+	    -> Affixing_Result<Prefix<wchar_t>, Suffix<wchar_t>,
+	                       Prefix<wchar_t>>;
+
+	template <Affixing_Mode m, class CallbackT>
+	auto for_each_p_s_p_3(const Prefix<wchar_t>& pe1,
+	                      const Suffix<wchar_t>& se1, std::wstring& word,
+	                      Hidden_Homonym skip_hidden_homonym,
+	                      CallbackT&& cb) const -> bool;
 
 	template <Affixing_Mode m>
 	auto strip_p_s_p_3(const Prefix<wchar_t>& pe1,
 	                   const Suffix<wchar_t>& se1, std::wstring& word,
 	                   Hidden_Homonym skip_hidden_homonym) const
-	    -> Affixing_Result<>;
+	    -> Affixing_Result<Prefix<wchar_t>, Suffix<wchar_t>,
+	                       Prefix<wchar_t>>;
 
 	template <Affixing_Mode m = FULL_WORD>
 	auto strip_2_prefixes_then_suffix(
@@ -325,9 +466,24 @@ struct Dict_Base : public Aff_Data {
 
 	    -> Compounding_Result;
 
-	auto suggest_priv(std::wstring& word, List_WStrings& out) const -> void;
+	template <class CallbackT>
+	auto for_each_root(std::wstring& word, CallbackT&& cb) const -> void;
 
-	auto suggest_low(std::wstring& word, List_WStrings& out) const -> void;
+	auto stem_priv(std::wstring& word, List_WStrings& out) const -> void;
+
+	auto analyze_priv(std::wstring& word, List_WStrings& out) const -> void;
+
+	auto suggest_priv(std::wstring& word, List_WStrings& out,
+	                  const Cancellation_Token* token = nullptr,
+	                  Executor* executor = nullptr) const -> void;
+
+	auto suggest_hyphenated(std::wstring& word, std::wstring_view orig_word,
+	                        List_WStrings& out,
+	                        const Cancellation_Token* token,
+	                        Executor* executor) const -> void;
+
+	auto suggest_low(std::wstring& word, List_WStrings& out,
+	                 const Cancellation_Token* token = nullptr) const -> void;
 
 	auto add_sug_if_correct(std::wstring& word, List_WStrings& out) const
 	    -> bool;
@@ -375,11 +531,11 @@ struct Dict_Base : public Aff_Data {
 	auto phonetic_suggest(std::wstring& word, List_WStrings& out) const
 	    -> void;
 
+	// suggestions for segments of hyphenated words, shared by copies
+	std::shared_ptr<Segment_Cache> segment_cache;
+
       public:
-	Dict_Base()
-	    : Aff_Data() // we explicity do value init so content is zeroed
-	{
-	}
+	Dict_Base();
 };
 
 /**
@@ -390,12 +546,77 @@ class Dictionary_Loading_Error : public std::runtime_error {
 	using std::runtime_error::runtime_error;
 };
 
+/**
+ * @brief How much memory Dictionary::trim() releases
+ */
+enum class Trim_Level {
+	SCRATCH /**< shrink the per-thread buffers */,
+	CACHES /**< also drop the optional caches, they are rebuilt on demand */,
+	ALL /**< also remove the slack from the word list */
+};
+
+/**
+ * @brief Suggestions stored in one reusable buffer
+ *
+ * The suggestions are concatenated in one string and delimited by an array
+ * of offsets. Reused across calls of Dictionary::suggest(), the buffers
+ * keep their capacity and the output needs no allocations after the first
+ * few calls. The views are valid until the next modification.
+ */
+class Suggestion_List {
+	std::string chars;
+	// suggestion i ends at ends[i] and starts where the previous one ends,
+	// so a moved-from object with empty members is a valid empty list
+	std::vector<size_t> ends;
+
+      public:
+	auto size() const noexcept { return ends.size(); }
+	auto empty() const noexcept { return ends.empty(); }
+	auto operator[](size_t i) const -> std::string_view
+	{
+		auto first = i == 0 ? 0 : ends[i - 1];
+		return std::string_view(chars).substr(first, ends[i] - first);
+	}
+	auto push_back(std::string_view s) -> void
+	{
+		chars += s;
+		ends.push_back(chars.size());
+	}
+	auto clear() noexcept -> void
+	{
+		chars.clear();
+		ends.clear();
+	}
+};
+
 /**
  * @brief The only important public class
  */
 class Dictionary : private Dict_Base {
+      public:
+	/**
+	 * @brief Default limit of the lookups in the word list per spell()
+	 *
+	 * Ordinary words need less than a thousand, the limit only cuts off
+	 * pathological input.
+	 */
+	static constexpr size_t DEFAULT_MAX_SPELL_PROBES = 100'000;
+	/**
+	 * @brief Default limit of the tried splits of a word per spell()
+	 */
+	static constexpr size_t DEFAULT_MAX_SPELL_SPLITS = 20'000;
+	/**
+	 * @brief Default size of the hot tier, see set_hot_words()
+	 *
+	 * A few thousand entries fit in the L2 cache.
+	 */
+	static constexpr size_t DEFAULT_HOT_WORDS = 4096;
+
+      private:
 	std::locale external_locale;
 	bool external_locale_known_utf8;
+	size_t max_spell_probes = DEFAULT_MAX_SPELL_PROBES;
+	size_t max_spell_splits = DEFAULT_MAX_SPELL_SPLITS;
 
 	Dictionary(std::istream& aff, std::istream& dic);
 	auto external_to_internal_encoding(const std::string& in,
@@ -404,8 +625,27 @@ class Dictionary : private Dict_Base {
 
 	auto internal_to_external_encoding(const std::wstring& wide_in,
 	                                   std::string& out) const -> bool;
+	auto input_word_to_internal(const std::string& in,
+	                            std::wstring& wide_out) const -> bool;
+
+	auto suggest_wide(const std::string& word, std::wstring& wide_word,
+	                  List_WStrings& wide_list,
+	                  const Cancellation_Token* token = nullptr,
+	                  Executor* executor = nullptr) const -> bool;
+	auto suggest_with_buffers(const std::string& word,
+	                          std::vector<std::string>& out,
+	                          std::wstring& wide_word,
+	                          List_WStrings& wide_list,
+	                          const Cancellation_Token* token = nullptr,
+	                          Executor* executor = nullptr) const -> void;
 
       public:
+	using Batch_Callback = std::function<void(
+	    size_t index, const std::vector<std::string>& suggestions)>;
+	using Suggest_Callback =
+	    std::function<void(std::vector<std::string>& suggestions)>;
+	using Error_Callback = std::function<void(std::exception_ptr error)>;
+
 	Dictionary();
 	auto static load_from_aff_dic(std::istream& aff, std::istream& dic)
 	    -> Dictionary;
@@ -413,10 +653,125 @@ class Dictionary : private Dict_Base {
 	    const std::string& file_path_without_extension) -> Dictionary;
 	auto imbue(const std::locale& loc) -> void;
 	auto imbue_utf8() -> void;
+	auto trim(Trim_Level level) -> void;
+	auto set_spell_limits(size_t max_probes, size_t max_splits) -> void;
+	auto set_hot_words(const std::vector<std::string>& sample,
+	                   size_t max_entries = DEFAULT_HOT_WORDS) -> void;
+	auto set_hot_words_cached(
+	    const std::string& file_path_without_extension,
+	    const std::vector<std::string>& sample,
+	    size_t max_entries = DEFAULT_HOT_WORDS, std::string cache_path = {})
+	    -> bool;
 	auto spell(const std::string& word) const -> bool;
+	auto spell(const std::string& word, Spell_Work& work) const -> bool;
+	auto spell_quick(const std::string& word) const -> bool;
 	auto suggest(const std::string& word,
 	             std::vector<std::string>& out) const -> void;
+	auto suggest(const std::string& word, Suggestion_List& out) const
+	    -> void;
+	auto suggest_async(const std::string& word,
+	                   Executor& executor = default_executor(),
+	                   const Cancellation_Token& token = {}) const
+	    -> std::future<std::vector<std::string>>;
+	auto suggest_async(const std::string& word, Suggest_Callback callback,
+	                   Error_Callback on_error,
+	                   Executor& executor = default_executor(),
+	                   const Cancellation_Token& token = {}) const -> void;
+	auto suggest_batch(const std::vector<std::string>& words,
+	                   const Batch_Callback& callback,
+	                   Executor& executor = default_executor(),
+	                   const Cancellation_Token& token = {}) const -> void;
+	auto stem(const std::string& word, std::vector<std::string>& out) const
+	    -> void;
+	auto analyze(const std::string& word,
+	             std::vector<std::string>& out) const -> void;
 };
+
+/**
+ * @brief Checks identifiers of source code by splitting them into subwords
+ *
+ * Identifiers like parseHttpResponse or max_buffer_len are split on case
+ * changes, underscores, digits and other punctuation, and each subword is
+ * checked with the dictionary. Verdicts for subwords are cached, since the
+ * same subwords repeat a lot in a code base. The object is not thread-safe,
+ * use one per thread.
+ */
+class Identifier_Checker {
+      public:
+	/**
+	 * @brief Subword given as byte offset and length in the identifier
+	 */
+	struct Subword {
+		size_t offset;
+		size_t length;
+		auto operator==(const Subword& other) const
+		{
+			return offset == other.offset && length == other.length;
+		}
+	};
+
+      private:
+	const Dictionary& dic;
+	std::unordered_map<std::string, bool> cache;
+	size_t cache_bytes = 0;
+	unsigned cache_generation;
+	std::string key;
+	std::vector<Subword> subwords;
+
+      public:
+	explicit Identifier_Checker(const Dictionary& dic);
+	~Identifier_Checker();
+	Identifier_Checker(const Identifier_Checker&) = delete;
+	auto operator=(const Identifier_Checker&) = delete;
+	auto static split(std::string_view identifier,
+	                  std::vector<Subword>& out) -> void;
+	auto spell_subword(std::string_view subword) -> bool;
+	auto check(std::string_view identifier, std::vector<Subword>& misspelled)
+	    -> bool;
+	auto cache_size() const -> size_t { return cache.size(); }
+	auto clear_cache() -> void;
+};
+
+/**
+ * @brief Result of identify_language()
+ *
+ * The vectors have one element per given dictionary.
+ */
+struct Language_Guess {
+	/**
+	 * @brief Index of the dictionary with the highest hit rate, or -1
+	 */
+	size_t best = size_t(-1);
+	std::vector<size_t> checked; /**< tokens checked, fewer if stopped */
+	std::vector<size_t> hits;    /**< tokens accepted */
+	auto hit_rate(size_t i) const -> double
+	{
+		return checked[i] ? double(hits[i]) / checked[i] : 0.0;
+	}
+};
+
+auto identify_language(std::string_view text,
+                       const std::vector<const Dictionary*>& dictionaries,
+                       Executor& executor = default_executor(),
+                       size_t max_tokens = 1000) -> Language_Guess;
+
+/**
+ * @brief Result of loading one dictionary with load_many()
+ */
+struct Load_Result {
+	std::string name; /**< as given to load_many() */
+	std::string path; /**< path without extension, empty if not found */
+	std::optional<Dictionary> dictionary; /**< empty on error */
+	std::string error; /**< the error message, empty on success */
+};
+
+auto load_many(const std::vector<std::string>& names, const Finder& finder,
+               Executor& executor = default_executor(),
+               size_t max_concurrent = 0) -> std::vector<Load_Result>;
+
+auto set_cache_budget(size_t bytes) -> void;
+auto get_cache_budget() -> size_t;
+auto get_cache_usage() -> size_t;
 } // namespace v3
 } // namespace nuspell
 #endif // NUSPELL_DICTIONARY_HXX
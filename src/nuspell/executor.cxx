@@ -0,0 +1,172 @@
+/* Copyright 2016-2019 Dimitrij Mijoski
+ *
+ * This file is part of Nuspell.
+ *
+ * Nuspell is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Nuspell is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Nuspell.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "executor.hxx"
+
+#include <iostream>
+
+namespace nuspell {
+inline namespace v3 {
+using namespace std;
+
+namespace {
+// identifies the pool and the queue of the current worker thread
+thread_local const Thread_Pool_Executor* current_pool = nullptr;
+thread_local size_t current_queue = 0;
+} // namespace
+
+/**
+ * @brief Starts the worker threads
+ * @param num_threads number of threads, zero means the number of hardware
+ * threads.
+ * @param on_error receives the exceptions thrown by tasks, called on the
+ * worker thread. If empty, they are printed to the standard error output.
+ */
+Thread_Pool_Executor::Thread_Pool_Executor(size_t num_threads,
+                                           Error_Handler on_error)
+    : on_error(move(on_error))
+{
+	if (num_threads == 0)
+		num_threads = max(thread::hardware_concurrency(), 1u);
+	for (size_t i = 0; i != num_threads; ++i)
+		queues.push_back(make_unique<Queue>());
+	threads.reserve(num_threads);
+	for (size_t i = 0; i != num_threads; ++i)
+		threads.emplace_back([this, i] { worker_loop(i); });
+}
+
+Thread_Pool_Executor::~Thread_Pool_Executor()
+{
+	{
+		auto lock = lock_guard<mutex>(idle_mtx);
+		stopping = true;
+	}
+	idle_cv.notify_all();
+	for (auto& t : threads)
+		t.join();
+}
+
+auto Thread_Pool_Executor::execute(std::function<void()> task) -> void
+{
+	auto idx = size_t();
+	if (current_pool == this)
+		idx = current_queue;
+	else
+		idx = next_queue++ % queues.size();
+	auto& q = *queues[idx];
+	{
+		auto lock = lock_guard<mutex>(q.mtx);
+		q.tasks.push_back(move(task));
+	}
+	{
+		auto lock = lock_guard<mutex>(idle_mtx);
+		++num_pending;
+	}
+	idle_cv.notify_one();
+}
+
+/**
+ * @brief Takes a task from the own queue, or steals one from another queue
+ */
+auto Thread_Pool_Executor::try_pop(size_t idx, std::function<void()>& task)
+    -> bool
+{
+	{
+		auto& q = *queues[idx];
+		auto lock = lock_guard<mutex>(q.mtx);
+		if (!q.tasks.empty()) {
+			task = move(q.tasks.back());
+			q.tasks.pop_back();
+			return true;
+		}
+	}
+	for (size_t i = 1; i != queues.size(); ++i) {
+		auto& q = *queues[(idx + i) % queues.size()];
+		auto lock = lock_guard<mutex>(q.mtx);
+		if (!q.tasks.empty()) {
+			task = move(q.tasks.front());
+			q.tasks.pop_front();
+			return true;
+		}
+	}
+	return false;
+}
+
+auto Thread_Pool_Executor::worker_loop(size_t idx) -> void
+{
+	current_pool = this;
+	current_queue = idx;
+	auto task = function<void()>();
+	for (;;) {
+		{
+			auto lock = unique_lock<mutex>(idle_mtx);
+			idle_cv.wait(lock,
+			             [&] { return num_pending != 0 || stopping; });
+			if (num_pending == 0)
+				return; // stopping and no more work
+			--num_pending;
+		}
+		// A pending task is reserved for this thread, so some queue
+		// holds it or will shortly hold it.
+		while (!try_pop(idx, task))
+			this_thread::yield();
+		try {
+			task();
+		}
+		catch (...) {
+			report_error(current_exception());
+		}
+		task = nullptr;
+	}
+}
+
+/**
+ * @brief Passes an exception of a task to the error handler
+ *
+ * The handler must not throw, if it does the exception is printed as well.
+ */
+auto Thread_Pool_Executor::report_error(std::exception_ptr e) -> void
+{
+	try {
+		if (on_error)
+			on_error(e);
+		else
+			rethrow_exception(e);
+	}
+	catch (const exception& ex) {
+		cerr << "Nuspell error: a task of the thread pool threw: "
+		     << ex.what() << '\n';
+	}
+	catch (...) {
+		cerr << "Nuspell error: a task of the thread pool threw\n";
+	}
+}
+
+/**
+ * @brief Gets the executor used when none is given explicitly
+ *
+ * It is a Thread_Pool_Executor with one thread per hardware thread, created
+ * on first use.
+ */
+auto default_executor() -> Executor&
+{
+	static auto pool = Thread_Pool_Executor();
+	return pool;
+}
+} // namespace v3
+} // namespace nuspell
@@ -0,0 +1,151 @@
+/* Copyright 2016-2019 Dimitrij Mijoski
+ *
+ * This file is part of Nuspell.
+ *
+ * Nuspell is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Nuspell is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Nuspell.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file
+ * @brief Executors for parallel work, PUBLIC HEADER.
+ */
+
+#ifndef NUSPELL_EXECUTOR_HXX
+#define NUSPELL_EXECUTOR_HXX
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace nuspell {
+inline namespace v3 {
+
+/**
+ * @brief Token for cancelling work that is in progress
+ *
+ * Copies of a token share the same state, so the party that started the work
+ * can keep one copy and cancel, while the work checks another copy.
+ */
+class Cancellation_Token {
+	std::shared_ptr<std::atomic<bool>> flag =
+	    std::make_shared<std::atomic<bool>>(false);
+
+      public:
+	auto cancel() -> void { *flag = true; }
+	auto is_cancelled() const -> bool { return *flag; }
+};
+
+/**
+ * @brief Interface for running the parallel work of Nuspell
+ *
+ * Implement this to run Nuspell's tasks on the thread pool of the host
+ * application. Tasks must not be run inline in execute() if that can block
+ * the caller for long, and every submitted task must eventually run. The
+ * tasks submitted by Nuspell do not throw, they deliver their errors to the
+ * caller that started the work.
+ */
+class Executor {
+      public:
+	virtual ~Executor() = default;
+
+	/**
+	 * @brief Schedules a task to be run on some thread
+	 */
+	virtual auto execute(std::function<void()> task) -> void = 0;
+
+	/**
+	 * @brief Number of tasks that can run at the same time
+	 */
+	virtual auto concurrency() const -> size_t = 0;
+};
+
+/**
+ * @brief Work-stealing thread pool, the default executor
+ *
+ * Each worker thread has its own queue. Tasks submitted from a worker go to
+ * its own queue and are run last-in first-out, tasks submitted from other
+ * threads are distributed round-robin. Idle workers steal from the other
+ * queues. The destructor runs the remaining tasks and joins the threads.
+ *
+ * An exception thrown by a task is caught and passed to the error handler,
+ * and the worker continues with the next task. The default handler prints
+ * the error to the standard error output.
+ */
+class Thread_Pool_Executor : public Executor {
+      public:
+	using Error_Handler = std::function<void(std::exception_ptr)>;
+
+      private:
+	struct Queue {
+		std::mutex mtx;
+		std::deque<std::function<void()>> tasks;
+	};
+	std::vector<std::unique_ptr<Queue>> queues;
+	std::vector<std::thread> threads;
+	std::mutex idle_mtx;
+	std::condition_variable idle_cv;
+	std::atomic<size_t> num_pending = 0;
+	std::atomic<size_t> next_queue = 0;
+	bool stopping = false;
+	Error_Handler on_error;
+
+	auto worker_loop(size_t idx) -> void;
+	auto try_pop(size_t idx, std::function<void()>& task) -> bool;
+	auto report_error(std::exception_ptr e) -> void;
+
+      public:
+	explicit Thread_Pool_Executor(size_t num_threads = 0,
+	                              Error_Handler on_error = {});
+	~Thread_Pool_Executor() override;
+	Thread_Pool_Executor(const Thread_Pool_Executor&) = delete;
+	auto operator=(const Thread_Pool_Executor&) = delete;
+
+	auto execute(std::function<void()> task) -> void override;
+	auto concurrency() const -> size_t override { return threads.size(); }
+};
+
+/**
+ * @brief Adapts a user-supplied function to the Executor interface
+ *
+ * The function receives the task and must arrange for it to run, e.g. by
+ * posting it to the thread pool of the application.
+ */
+class Function_Executor : public Executor {
+	std::function<void(std::function<void()>)> submit;
+	size_t num_threads;
+
+      public:
+	Function_Executor(std::function<void(std::function<void()>)> submit,
+	                  size_t concurrency)
+	    : submit(std::move(submit)), num_threads(concurrency)
+	{
+	}
+	auto execute(std::function<void()> task) -> void override
+	{
+		submit(std::move(task));
+	}
+	auto concurrency() const -> size_t override { return num_threads; }
+};
+
+auto default_executor() -> Executor&;
+
+} // namespace v3
+} // namespace nuspell
+#endif // NUSPELL_EXECUTOR_HXX
@@ -20,9 +20,12 @@
 #include "finder.hxx"
 #include "utils.hxx"
 
+#include <chrono>
 #include <fstream>
+#include <future>
 #include <iomanip>
 #include <iostream>
+#include <memory>
 
 #include <boost/locale.hpp>
 
@@ -61,6 +64,8 @@ enum Mode {
 struct Args_t {
 	Mode mode = DEFAULT_MODE;
 	bool unicode_segmentation = false;
+	bool identifiers = false;
+	bool startup_profile = false;
 	string program_name = "nuspell";
 	string dictionary;
 	string encoding;
@@ -88,10 +93,11 @@ auto Args_t::parse_args(int argc, char* argv[]) -> void
 	int c;
 	// The program can run in various modes depending on the
 	// command line options. mode is FSM state, this while loop is FSM.
-	const char* shortopts = ":d:i:aDGLSlhv";
+	const char* shortopts = ":d:i:aDGILSlhv";
 	const struct option longopts[] = {
 	    {"version", 0, nullptr, 'v'},
 	    {"help", 0, nullptr, 'h'},
+	    {"startup-profile", 0, nullptr, 'P'},
 	    {nullptr, 0, nullptr, 0},
 	};
 	while ((c = getopt_long(argc, argv, shortopts, longopts, nullptr)) !=
@@ -155,6 +161,14 @@ auto Args_t::parse_args(int argc, char* argv[]) -> void
 		case 'S':
 			unicode_segmentation = true;
 
+			break;
+		case 'I':
+			identifiers = true;
+
+			break;
+		case 'P':
+			startup_profile = true;
+
 			break;
 		case 'h':
 			if (mode == DEFAULT_MODE)
@@ -207,14 +221,17 @@ class My_Dictionary : public Dictionary {
 		static_cast<Dictionary&>(*this) = move(d);
 		return *this;
 	}
+	auto is_personal(const string& word) const
+	{
+		auto r = personal.equal_range(word);
+		return r.first != r.second;
+	}
 	auto spell(const string& word) const
 	{
 		auto correct = Dictionary::spell(word);
 		if (correct)
 			return true;
-		auto r = personal.equal_range(word);
-		correct = r.first != r.second;
-		return correct;
+		return is_personal(word);
 	}
 	auto parse_personal_dict(istream& in, const locale& external_locale)
 	{
@@ -265,8 +282,9 @@ auto print_help(const string& program_name) -> void
 	auto& o = cout;
 	o << "Usage:\n"
 	     "\n";
-	o << p << " [-S] [-d dict_NAME] [-i enc] [file_name]...\n";
-	o << p << " -l|-G [-L] [-S] [-d dict_NAME] [-i enc] [file_name]...\n";
+	o << p << " [-S] [-I] [-d dict_NAME] [-i enc] [file_name]...\n";
+	o << p
+	  << " -l|-G [-L] [-S] [-I] [-d dict_NAME] [-i enc] [file_name]...\n";
 	o << p << " -D|-h|--help|-v|--version\n";
 	o << "\n"
 	     "Check spelling of each FILE. Without FILE, check standard "
@@ -281,8 +299,16 @@ auto print_help(const string& program_name) -> void
 	     "  -G            print only correct words or lines\n"
 	     "  -L            lines mode\n"
 	     "  -S            use Unicode text segmentation to extract words\n"
+	     "  -I            identifier mode, split camelCase, snake_case and\n"
+	     "                digits into subwords and check them\n"
 	     "  -h, --help    print this help and exit\n"
 	     "  -v, --version print version number and exit\n"
+	     "  --startup-profile\n"
+	     "                print the duration of each startup phase\n"
+	     "\n"
+	     "If di_CT contains a slash, it is a path to the dictionary\n"
+	     "without the extension and the dictionary directories are not\n"
+	     "searched.\n"
 	     "\n";
 	o << "Example: " << p << " -d en_US file.txt\n";
 	o << "\n"
@@ -342,14 +368,18 @@ auto list_dictionaries(const Finder& f) -> void
 }
 
 auto process_word(
-    Mode mode, const My_Dictionary& dic, const string& line, streampos pos_line,
-    string::const_iterator b, string::const_iterator c, bool tellg_supported,
-    string& word,
+    Mode mode, const My_Dictionary& dic, Identifier_Checker* ident,
+    const string& line, streampos pos_line, string::const_iterator b,
+    string::const_iterator c, bool tellg_supported, string& word,
     vector<pair<string::const_iterator, string::const_iterator>>& wrong_words,
     vector<string>& suggestions, ostream& out)
 {
 	word.assign(b, c);
-	auto correct = dic.spell(word);
+	auto correct = false;
+	if (ident)
+		correct = ident->spell_subword(word) || dic.is_personal(word);
+	else
+		correct = dic.spell(word);
 	switch (mode) {
 	case DEFAULT_MODE: {
 		if (correct) {
@@ -390,6 +420,32 @@ auto process_word(
 	}
 }
 
+/**
+ * @brief Processes a token, or each of its subwords in identifier mode.
+ */
+auto process_token(
+    Mode mode, const My_Dictionary& dic, Identifier_Checker* ident,
+    const string& line, streampos pos_line, string::const_iterator b,
+    string::const_iterator c, bool tellg_supported, string& word,
+    vector<pair<string::const_iterator, string::const_iterator>>& wrong_words,
+    vector<string>& suggestions, ostream& out)
+{
+	if (!ident) {
+		process_word(mode, dic, ident, line, pos_line, b, c,
+		             tellg_supported, word, wrong_words, suggestions,
+		             out);
+		return;
+	}
+	auto static thread_local subwords = vector<Identifier_Checker::Subword>();
+	Identifier_Checker::split(string_view(&*b, c - b), subwords);
+	for (auto& sw : subwords) {
+		auto sb = b + sw.offset;
+		process_word(mode, dic, ident, line, pos_line, sb,
+		             sb + sw.length, tellg_supported, word, wrong_words,
+		             suggestions, out);
+	}
+}
+
 auto process_line(
     Mode mode, const string& line,
     const vector<pair<string::const_iterator, string::const_iterator>>&
@@ -411,7 +467,8 @@ auto process_line(
 }
 
 auto whitespace_segmentation_loop(istream& in, ostream& out,
-                                  const My_Dictionary& dic, Mode mode)
+                                  const My_Dictionary& dic, Mode mode,
+                                  Identifier_Checker* ident)
 {
 	auto line = string();
 	auto word = string();
@@ -437,9 +494,9 @@ auto whitespace_segmentation_loop(istream& in, ostream& out,
 				break;
 			auto c = find_if(b, end(line), isspace);
 
-			process_word(mode, dic, line, pos_line, b, c,
-			             tellg_supported, word, wrong_words,
-			             suggestions, out);
+			process_token(mode, dic, ident, line, pos_line, b, c,
+			              tellg_supported, word, wrong_words,
+			              suggestions, out);
 
 			a = c;
 		}
@@ -451,7 +508,8 @@ auto whitespace_segmentation_loop(istream& in, ostream& out,
 }
 
 auto unicode_segentation_loop(istream& in, ostream& out,
-                              const My_Dictionary& dic, Mode mode)
+                              const My_Dictionary& dic, Mode mode,
+                              Identifier_Checker* ident)
 {
 	namespace b = boost::locale::boundary;
 	auto line = string();
@@ -479,9 +537,9 @@ auto unicode_segentation_loop(istream& in, ostream& out,
 			auto b = begin(segment);
 			auto c = end(segment);
 
-			process_word(mode, dic, line, pos_line, b, c,
-			             tellg_supported, word, wrong_words,
-			             suggestions, out);
+			process_token(mode, dic, ident, line, pos_line, b, c,
+			              tellg_supported, word, wrong_words,
+			              suggestions, out);
 
 			a = c;
 		}
@@ -507,24 +565,67 @@ ostream& operator<<(ostream& out, const locale& loc)
 }
 } // namespace std
 
-int main(int argc, char* argv[])
-{
-	// May speed up I/O. After this, don't use C printf, scanf etc.
-	ios_base::sync_with_stdio(false);
+/**
+ * @brief Durations of the startup phases, reported with --startup-profile.
+ */
+class Startup_Profile {
+	using clock = chrono::steady_clock;
+	clock::time_point start = clock::now();
+	clock::time_point last = start;
+	vector<pair<string, clock::duration>> phases;
 
-	auto args = Args_t(argc, argv);
-	if (args.mode == ERROR_MODE) {
-		cerr << "Invalid (combination of) arguments, try '"
-		     << args.program_name << " --help' for more information\n";
-		return 1;
+      public:
+	/**
+	 * @brief Ends a phase that started at the end of the previous one.
+	 */
+	auto mark(const string& phase) -> void
+	{
+		auto now = clock::now();
+		phases.emplace_back(phase, now - last);
+		last = now;
+	}
+	/**
+	 * @brief Adds a phase that was run in parallel, e.g. in a thread.
+	 */
+	auto add(const string& phase, clock::duration d) -> void
+	{
+		phases.emplace_back(phase, d);
 	}
-	boost::locale::generator gen;
-	auto loc = std::locale();
+	auto report(ostream& out) const -> void
+	{
+		auto ms = [](clock::duration d) {
+			return chrono::duration<double, milli>(d).count();
+		};
+		out << "Startup profile in ms:\n" << fixed << setprecision(3);
+		for (auto& p : phases)
+			out << "  " << left << setw(34) << p.first << right
+			    << setw(10) << ms(p.second) << '\n';
+		out << "  " << left << setw(34) << "total" << right << setw(10)
+		    << ms(last - start) << '\n';
+		out << defaultfloat << setprecision(6);
+	}
+};
+
+/**
+ * @brief Creates the I/O locale with only the facets that are needed.
+ *
+ * Generating all the facets of Boost.Locale takes a few milliseconds, which
+ * is a noticeable part of the startup for short inputs.
+ */
+auto create_locale(const string& encoding, bool segmentation, locale& loc)
+    -> bool
+{
+	namespace bl = boost::locale;
+	bl::generator gen;
+	auto categories = bl::information_facet | bl::codepage_facet;
+	if (segmentation)
+		categories |= bl::boundary_facet;
+	gen.categories(categories);
 	try {
-		if (args.encoding.empty())
+		if (encoding.empty())
 			loc = gen("");
 		else
-			loc = gen("en_US." + args.encoding);
+			loc = gen("en_US." + encoding);
 	}
 	catch (const boost::locale::conv::invalid_charset_error& e) {
 		cerr << e.what() << '\n';
@@ -532,11 +633,59 @@ int main(int argc, char* argv[])
 		cerr << "Nuspell error: see `locale -m` for supported "
 		        "encodings.\n";
 #endif
-		return 1;
+		return false;
 	}
-	cin.imbue(loc);
-	cout.imbue(loc);
+	return true;
+}
+
+struct Loaded_Dictionary {
+	string path;
+	Dictionary dic;
+	chrono::steady_clock::duration duration = {};
+};
 
+/**
+ * @brief Finds and loads a dictionary, meant to be run in a thread.
+ *
+ * If the dictionary is given as a path, the dictionary directories are not
+ * searched at all.
+ *
+ * @param name name or path of dictionary without the trailing .aff/.dic.
+ * @return the loaded dictionary, with empty path if not found.
+ */
+auto find_and_load(const string& name) -> Loaded_Dictionary
+{
+#ifdef _WIN32
+	auto const PATH_SEPS = "\\/";
+#else
+	auto const PATH_SEPS = '/';
+#endif
+	auto start = chrono::steady_clock::now();
+	auto ret = Loaded_Dictionary();
+	if (name.find_first_of(PATH_SEPS) != name.npos)
+		ret.path = name;
+	else
+		ret.path = Finder::search_all_dirs_for_dicts()
+		               .get_dictionary_path(name);
+	if (!ret.path.empty())
+		ret.dic = Dictionary::load_from_path(ret.path);
+	ret.duration = chrono::steady_clock::now() - start;
+	return ret;
+}
+
+int main(int argc, char* argv[])
+{
+	auto profile = Startup_Profile();
+
+	// May speed up I/O. After this, don't use C printf, scanf etc.
+	ios_base::sync_with_stdio(false);
+
+	auto args = Args_t(argc, argv);
+	if (args.mode == ERROR_MODE) {
+		cerr << "Invalid (combination of) arguments, try '"
+		     << args.program_name << " --help' for more information\n";
+		return 1;
+	}
 	switch (args.mode) {
 	case HELP_MODE:
 		print_help(args.program_name);
@@ -547,12 +696,20 @@ int main(int argc, char* argv[])
 	default:
 		break;
 	}
-	clog << "INFO: I/O  locale " << loc << '\n';
-
-	auto f = Finder::search_all_dirs_for_dicts();
+	profile.mark("arguments");
 
+	auto loc = std::locale();
+	auto has_loc = false;
+	if (args.mode == LIST_DICTIONARIES_MODE || args.dictionary.empty()) {
+		if (!create_locale(args.encoding, args.unicode_segmentation,
+		                   loc))
+			return 1;
+		has_loc = true;
+		profile.mark("locale");
+	}
 	if (args.mode == LIST_DICTIONARIES_MODE) {
-		list_dictionaries(f);
+		cout.imbue(loc);
+		list_dictionaries(Finder::search_all_dirs_for_dicts());
 		return 0;
 	}
 	if (args.dictionary.empty()) {
@@ -569,27 +726,61 @@ int main(int argc, char* argv[])
 		cerr << "No dictionary provided and can not infer from OS "
 		        "locale\n";
 	}
-	auto filename = f.get_dictionary_path(args.dictionary);
-	if (filename.empty()) {
-		cerr << "Dictionary " << args.dictionary << " not found\n";
-		return 1;
+
+	// The dictionary is loaded while the locale is created and the
+	// input is waited for.
+	auto loading = async(launch::async, find_and_load, args.dictionary);
+
+	if (!has_loc) {
+		if (!create_locale(args.encoding, args.unicode_segmentation,
+		                   loc)) {
+			// Join the loading thread before the static objects it
+			// uses are destroyed. The future would wait in its
+			// destructor too, but that is easy to miss.
+			loading.wait();
+			return 1;
+		}
+		profile.mark("locale");
+	}
+	cin.imbue(loc);
+	cout.imbue(loc);
+	clog << "INFO: I/O  locale " << loc << '\n';
+	if (args.files.empty()) {
+		cin.peek();
+		profile.mark("waiting for input");
 	}
-	clog << "INFO: Pointed dictionary " << filename << ".{dic,aff}\n";
+
 	auto dic = My_Dictionary();
 	try {
-		dic = Dictionary::load_from_path(filename);
+		auto loaded = loading.get();
+		profile.mark("waiting for dictionary");
+		profile.add("(in parallel) search and load", loaded.duration);
+		if (loaded.path.empty()) {
+			cerr << "Dictionary " << args.dictionary
+			     << " not found\n";
+			return 1;
+		}
+		clog << "INFO: Pointed dictionary " << loaded.path
+		     << ".{dic,aff}\n";
+		dic = move(loaded.dic);
 		dic.parse_personal_dict(args.dictionary, loc);
+		profile.mark("personal dictionary");
 	}
 	catch (const Dictionary_Loading_Error& e) {
 		cerr << e.what() << '\n';
 		return 1;
 	}
 	dic.imbue(loc);
+	auto ident = unique_ptr<Identifier_Checker>();
+	if (args.identifiers)
+		ident = make_unique<Identifier_Checker>(dic);
+	if (args.startup_profile)
+		profile.report(clog);
 	auto loop_function = whitespace_segmentation_loop;
 	if (args.unicode_segmentation)
 		loop_function = unicode_segentation_loop;
 	if (args.files.empty()) {
-		loop_function(cin, cout, dic, args.mode);
+		loop_function(cin, cout, dic, args.mode, ident.get());
 	}
 	else {
 		for (auto& file_name : args.files) {
@@ -599,7 +790,7 @@ int main(int argc, char* argv[])
 				return 1;
 			}
 			in.imbue(loc);
-			loop_function(in, cout, dic, args.mode);
+			loop_function(in, cout, dic, args.mode, ident.get());
 		}
 	}
 	return 0;
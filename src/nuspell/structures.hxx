@@ -26,6 +26,7 @@
 
 #include <algorithm>
 #include <cmath>
+#include <cstdint>
 #include <functional>
 #include <iterator>
 #include <stack>
@@ -546,6 +547,7 @@ class Hash_Multiset {
 
 	auto size() const { return sz; }
 	auto empty() const { return size() == 0; }
+	auto bucket_count() const { return data.size(); }
 
 	auto rehash(size_t count)
 	{
@@ -564,7 +566,7 @@ class Hash_Multiset {
 		n.rehash(count);
 		for (auto& b : data) {
 			for (auto& x : b) {
-				n.insert(x);
+				n.insert(std::move(x));
 			}
 		}
 		data.swap(n.data);
@@ -577,7 +579,43 @@ class Hash_Multiset {
 		rehash(std::ceil(count / max_load_fact));
 	}
 
-	auto insert(const_reference value)
+	/**
+	 * @brief Removes the bucket slack left by earlier reserve() or growth.
+	 */
+	auto shrink_to_fit() -> void
+	{
+		if (empty()) {
+			data = {};
+			max_load_factor_capacity = 0;
+			return;
+		}
+		auto n = Hash_Multiset();
+		n.reserve(size());
+		if (n.data.size() >= data.size())
+			return;
+		for (auto& b : data) {
+			for (auto& x : b) {
+				n.insert(std::move(x));
+			}
+		}
+		data.swap(n.data);
+		max_load_factor_capacity = n.max_load_factor_capacity;
+	}
+
+	auto insert(const_reference value) { return insert_priv(value); }
+	auto insert(value_type&& value)
+	{
+		return insert_priv(std::move(value));
+	}
+	template <class... Args>
+	auto emplace(Args&&... a)
+	{
+		return insert_priv(value_type(std::forward<Args>(a)...));
+	}
+
+      private:
+	template <class V>
+	auto insert_priv(V&& value)
 	{
 		using namespace std;
 		auto hash = hasher();
@@ -591,7 +629,7 @@ class Hash_Multiset {
 		auto& bucket = data[h_mod];
 		if (bucket.size() == 0 || bucket.size() == 1 ||
 		    key == key_extract(bucket.back())) {
-			bucket.push_back(value);
+			bucket.push_back(std::forward<V>(value));
 			++sz;
 			return end(bucket) - 1;
 		}
@@ -600,30 +638,34 @@ class Hash_Multiset {
 			    return key == key_extract(x);
 		    });
 		if (last != rend(bucket)) {
-			auto ret = bucket.insert(last.base(), value);
+			auto ret =
+			    bucket.insert(last.base(), std::forward<V>(value));
 			++sz;
 			return ret;
 		}
 
-		bucket.push_back(value);
+		bucket.push_back(std::forward<V>(value));
 		++sz;
 		return end(bucket) - 1;
 	}
-	template <class... Args>
-	auto emplace(Args&&... a)
+
+      public:
+	auto equal_range(const key_type& key) const
+	    -> std::pair<local_const_iterator, local_const_iterator>
 	{
-		return insert(value_type(std::forward<Args>(a)...));
+		return equal_range(key, hasher()(key));
 	}
 
-	auto equal_range(const key_type& key) const
+	/**
+	 * @brief Same as equal_range(key), with the hash already computed.
+	 */
+	auto equal_range(const key_type& key, size_t h) const
 	    -> std::pair<local_const_iterator, local_const_iterator>
 	{
 		using namespace std;
-		auto hash = hasher();
 		auto key_extract = KeyExtract();
 		if (data.empty())
 			return {};
-		auto h = hash(key);
 		auto h_mod = h & (data.size() - 1);
 		auto& bucket = data[h_mod];
 		if (bucket.empty())
@@ -650,6 +692,136 @@ class Hash_Multiset {
 	}
 };
 
+/**
+ * @brief Small copy of the most used part of a Hash_Multiset.
+ *
+ * Holds copies of all the values of a few chosen keys in contiguous memory,
+ * small enough to stay in the CPU cache, with a flat open addressing index.
+ * It is consulted before the big table and gives the same ranges, but over
+ * its own copies. Because it owns the copies, it stays valid when the big
+ * table is copied, moved or rehashed.
+ */
+template <class Value, class Key, class KeyExtract>
+class Hot_Subset {
+      private:
+	using storage_type = boost::container::small_vector<Value, 1>;
+	struct Slot {
+		size_t hash = 0;
+		uint32_t first = 0;
+		uint32_t count = 0; // zero for empty slot
+	};
+	storage_type values;
+	std::vector<Slot> slots;
+
+      public:
+	using key_type = Key;
+	using value_type = Value;
+	using hasher = std::hash<Key>;
+	using local_const_iterator = typename storage_type::const_iterator;
+
+	Hot_Subset() = default;
+
+	auto size() const { return values.size(); }
+	auto empty() const { return values.empty(); }
+	auto clear() -> void
+	{
+		values = {};
+		slots = {};
+	}
+
+	/**
+	 * @brief Gets the keys in the subset, in the order given to assign()
+	 */
+	auto keys(std::vector<Key>& out) const -> void
+	{
+		auto key_extract = KeyExtract();
+		out.clear();
+		for (auto& v : values)
+			if (out.empty() || key_extract(v) != out.back())
+				out.push_back(key_extract(v));
+	}
+
+	/**
+	 * @brief Fills the subset with all the values of the given keys.
+	 *
+	 * Keys missing from the source and repeated keys are skipped. Stops
+	 * when adding the next key would exceed @p max_values values.
+	 *
+	 * @param source the big table, usually a Hash_Multiset.
+	 * @param keys keys, the most important first.
+	 * @param max_values limit of the number of copied values.
+	 */
+	template <class Source, class Range>
+	auto assign(const Source& source, const Range& keys, size_t max_values)
+	    -> void
+	{
+		using namespace std;
+		clear();
+		auto key_extract = KeyExtract();
+		auto chosen = vector<Slot>();
+		for (auto& key : keys) {
+			auto r = source.equal_range(key);
+			auto n = size_t(r.second - r.first);
+			if (n == 0)
+				continue;
+			if (values.size() + n > max_values)
+				break;
+			auto h = hasher()(key);
+			auto same_key = [&](const Slot& c) {
+				return c.hash == h &&
+				       key_extract(values[c.first]) == key;
+			};
+			if (any_of(begin(chosen), end(chosen), same_key))
+				continue;
+			chosen.push_back({h, uint32_t(values.size()),
+			                  uint32_t(n)});
+			values.insert(end(values), r.first, r.second);
+		}
+		if (chosen.empty())
+			return;
+		size_t capacity = 16;
+		while (capacity < chosen.size() * 2)
+			capacity <<= 1;
+		slots.resize(capacity);
+		for (auto& c : chosen) {
+			auto i = c.hash & (capacity - 1);
+			while (slots[i].count != 0)
+				i = (i + 1) & (capacity - 1);
+			slots[i] = c;
+		}
+	}
+
+	/**
+	 * @brief Finds the values of a key.
+	 *
+	 * @param key the key.
+	 * @param h the hash of the key.
+	 * @param[out] found whether the key is in the subset. If not, the
+	 * key can still be in the big table.
+	 */
+	auto equal_range(const key_type& key, size_t h, bool& found) const
+	    -> std::pair<local_const_iterator, local_const_iterator>
+	{
+		auto key_extract = KeyExtract();
+		found = false;
+		if (slots.empty())
+			return {};
+		auto mask = slots.size() - 1;
+		for (auto i = h & mask;; i = (i + 1) & mask) {
+			auto& s = slots[i];
+			if (s.count == 0)
+				return {};
+			if (s.hash != h)
+				continue;
+			auto first = begin(values) + s.first;
+			if (key_extract(*first) != key)
+				continue;
+			found = true;
+			return {first, first + s.count};
+		}
+	}
+};
+
 struct Condition_Exception : public std::runtime_error {
 	using std::runtime_error::runtime_error;
 };
@@ -844,6 +1016,7 @@ class Prefix {
 	Str appending;
 	Flag_Set cont_flags;
 	Cond condition;
+	std::uint32_t morph_fields = 0; /**< index in Morph_Table */
 
 	auto to_root(Str& word) const -> Str&
 	{
@@ -884,6 +1057,7 @@ class Suffix {
 	Str appending;
 	Flag_Set cont_flags;
 	Cond condition;
+	std::uint32_t morph_fields = 0; /**< index in Morph_Table */
 
 	auto to_root(Str& word) const -> Str&
 	{
@@ -1421,6 +1595,13 @@ struct Compound_Pattern {
 class Compound_Rule_Table {
 	std::vector<std::u16string> rules;
 	Flag_Set all_flags;
+	// The rules with each flag replaced by BIT_BASE + its index in
+	// all_flags, used when there are at most 64 flags.
+	std::vector<std::u16string> bit_rules;
+	static constexpr char16_t BIT_BASE = 0x100;
+	// Bit (f % 64) is set for each flag f in all_flags. Most flags that
+	// are not in any rule are rejected with it without a search.
+	std::uint64_t flag_filter = 0;
 
 	auto fill_all_flags() -> void;
 
@@ -1454,34 +1635,47 @@ class Compound_Rule_Table {
 };
 auto inline Compound_Rule_Table::fill_all_flags() -> void
 {
+	all_flags.clear();
 	for (auto& f : rules) {
 		all_flags += f;
 	}
 	all_flags.erase(u'?');
 	all_flags.erase(u'*');
+	flag_filter = 0;
+	for (auto f : all_flags)
+		flag_filter |= std::uint64_t(1) << (f % 64);
+	bit_rules.clear();
+	if (all_flags.size() > 64)
+		return;
+	for (auto& r : rules) {
+		auto& br = bit_rules.emplace_back(r);
+		// same parsing as match_simple_regex(), a flag optionally
+		// followed by an operator
+		for (size_t i = 0; i != r.size(); ++i) {
+			if (r[i] == u'?' || r[i] == u'*') {
+				// the operator char used as a flag, rare
+				bit_rules.clear();
+				return;
+			}
+			auto idx = all_flags.find(r[i]) - all_flags.begin();
+			br[i] = BIT_BASE + idx;
+			if (i + 1 != r.size() &&
+			    (r[i + 1] == u'?' || r[i + 1] == u'*'))
+				++i;
+		}
+	}
 }
 
 auto inline Compound_Rule_Table::has_any_of_flags(const Flag_Set& f) const
     -> bool
 {
-	using std::begin;
-	using std::end;
-	struct Out_Iter_One_Bool {
-		bool* value = nullptr;
-		auto& operator++() { return *this; }
-		auto& operator++(int) { return *this; }
-		auto& operator*() { return *this; }
-		auto& operator=(char16_t)
-		{
-			*value = true;
-			return *this;
-		}
-	};
-	auto has_intersection = false;
-	auto out_it = Out_Iter_One_Bool{&has_intersection};
-	std::set_intersection(begin(all_flags), end(all_flags), begin(f),
-	                      end(f), out_it);
-	return has_intersection;
+	for (auto flag : f) {
+		if ((flag_filter >> (flag % 64) & 1) == 0)
+			continue;
+		if (all_flags.contains(flag))
+			return true;
+	}
+	return false;
 }
 
 template <class DataIter, class PatternIter, class FuncEq = std::equal_to<>>
@@ -1545,11 +1739,38 @@ auto inline match_compund_rule(const std::vector<const Flag_Set*>& words_data,
 	    [](const Flag_Set* d, char16_t p) { return d->contains(p); });
 }
 
+/**
+ * @brief Checks if the flags of the compound parts match any rule
+ *
+ * With at most 64 distinct flags in the rules, the flags of each part are
+ * first reduced to a bit mask of the rule flags, and the rules are matched
+ * with bit tests.
+ */
 auto inline Compound_Rule_Table::match_any_rule(
     const std::vector<const Flag_Set*>& data) const -> bool
 {
-	return any_of(begin(rules), end(rules), [&](const std::u16string& p) {
-		return match_compund_rule(data, p);
+	if (bit_rules.empty())
+		return any_of(begin(rules), end(rules), [&](auto& p) {
+			return match_compund_rule(data, p);
+		});
+	auto masks = boost::container::small_vector<uint64_t, 8>();
+	for (auto d : data) {
+		auto mask = uint64_t(0);
+		auto it = all_flags.begin();
+		for (auto f : *d) {
+			it = std::lower_bound(it, all_flags.end(), f);
+			if (it == all_flags.end())
+				break;
+			if (*it == f)
+				mask |= uint64_t(1) << (it - all_flags.begin());
+		}
+		masks.push_back(mask);
+	}
+	auto has_bit = [](uint64_t mask, char16_t p) {
+		return (mask >> (p - BIT_BASE)) & 1;
+	};
+	return any_of(begin(bit_rules), end(bit_rules), [&](auto& p) {
+		return match_simple_regex(masks, p, has_bit);
 	});
 }
 
@@ -2122,133 +2343,151 @@ auto Similarity_Group<CharT>::parse(const Str& s) -> void
 	}
 }
 
+/**
+ * @brief Table of PHONE rules, the phonetic transformation
+ *
+ * The rule patterns are parsed once, when the table is set, into Rule.
+ * Rules that are malformed can never match and are dropped.
+ */
 template <class CharT>
 class Phonetic_Table {
 	using Str = std::basic_string<CharT>;
 	using Pair_Str = std::pair<Str, Str>;
 
-	struct Phonet_Match_Result {
-		size_t count_matched = 0;
+	/**
+	 * @brief Parsed PHONE rule
+	 *
+	 * A pattern consists of a literal, an optional class of chars in
+	 * parentheses, an optional '<', minus signs for the chars that are
+	 * not replaced, an optional priority digit and the anchors '^', '^^'
+	 * and '$'.
+	 */
+	struct Rule {
+		CharT first;    // first char of the pattern, for lookup
+		Str literal;    // matched as is
+		Str char_class; // one char from it is matched if has_class
+		Str replacement;
+		size_t count_matched;
 		size_t go_back_before_replace = 0;
 		size_t priority = 5;
+		bool has_class = false;
 		bool go_back_after_replace = false;
+		bool at_begin_only = false;
 		bool treat_next_as_begin = false;
-		operator bool() { return count_matched; }
+		bool at_end_only = false;
 	};
 
-	std::vector<std::pair<Str, Str>> table;
-	auto order() -> void;
-	auto static match(const Str& data, size_t i, const Str& pattern,
-	                  bool at_begin) -> Phonet_Match_Result;
+	std::vector<Rule> rules;
+	auto set(const std::vector<Pair_Str>& v) -> void;
+	auto static parse(const Str& pattern, Rule& r) -> bool;
+	auto static match(const Str& data, size_t i, const Rule& r,
+	                  bool at_begin) -> bool;
 
       public:
 	Phonetic_Table() = default;
-	Phonetic_Table(const std::vector<Pair_Str>& v) : table(v) { order(); }
-	Phonetic_Table(std::vector<Pair_Str>&& v) : table(move(v)) { order(); }
+	Phonetic_Table(const std::vector<Pair_Str>& v) { set(v); }
 	auto& operator=(const std::vector<Pair_Str>& v)
 	{
-		table = v;
-		order();
-		return *this;
-	}
-	auto& operator=(std::vector<Pair_Str>&& v)
-	{
-		table = move(v);
-		order();
+		set(v);
 		return *this;
 	}
 	auto replace(Str& word) const -> bool;
 };
 
 template <class CharT>
-auto Phonetic_Table<CharT>::order() -> void
+auto Phonetic_Table<CharT>::set(const std::vector<Pair_Str>& v) -> void
 {
-	stable_sort(begin(table), end(table), [](auto& pair1, auto& pair2) {
-		if (pair2.first.empty())
-			return false;
-		if (pair1.first.empty())
-			return true;
-		return pair1.first[0] < pair2.first[0];
-	});
-	auto it = find_if_not(begin(table), end(table),
-	                      [](auto& p) { return p.first.empty(); });
-	table.erase(begin(table), it);
-	for (auto& r : table) {
-		if (r.second == NUSPELL_LITERAL(CharT, "_"))
-			r.second.clear();
+	rules.clear();
+	for (auto& p : v) {
+		auto r = Rule();
+		if (!parse(p.first, r))
+			continue;
+		if (p.second != NUSPELL_LITERAL(CharT, "_"))
+			r.replacement = p.second;
+		rules.push_back(std::move(r));
 	}
+	stable_sort(begin(rules), end(rules),
+	            [](auto& r1, auto& r2) { return r1.first < r2.first; });
 }
 
+/**
+ * @brief Parses a pattern of a PHONE rule
+ * @return false if the rule is malformed and can never match
+ */
 template <class CharT>
-auto Phonetic_Table<CharT>::match(const Str& data, size_t i, const Str& pattern,
-                                  bool at_begin) -> Phonet_Match_Result
+auto Phonetic_Table<CharT>::parse(const Str& pattern, Rule& r) -> bool
 {
-	auto ret = Phonet_Match_Result();
+	if (pattern.empty())
+		return false;
+	r.first = pattern[0];
 	auto j =
 	    pattern.find_first_of(NUSPELL_LITERAL(CharT, "(<-0123456789^$"));
 	if (j == pattern.npos)
 		j = pattern.size();
-	if (data.compare(i, j, pattern, 0, j) == 0)
-		ret.count_matched = j;
-	else
-		return {};
-	if (j == pattern.size())
-		return ret;
-	if (pattern[j] == '(') {
+	r.literal.assign(pattern, 0, j);
+	auto count_matched = j;
+	if (j != pattern.size() && pattern[j] == '(') {
 		auto k = pattern.find(')', j);
 		if (k == pattern.npos)
-			return {}; // bad rule
-		auto x = std::char_traits<CharT>::find(
-		    &pattern[j + 1], k - (j + 1), data[i + j]);
-		if (!x)
-			return {};
+			return false;
+		r.char_class.assign(pattern, j + 1, k - (j + 1));
+		r.has_class = true;
 		j = k + 1;
-		ret.count_matched += 1;
+		count_matched += 1;
 	}
+	r.count_matched = count_matched;
 	if (j == pattern.size())
-		return ret;
+		return true;
 	if (pattern[j] == '<') {
-		ret.go_back_after_replace = true;
+		r.go_back_after_replace = true;
 		++j;
 	}
 	auto k = pattern.find_first_not_of('-', j);
-	if (k == pattern.npos) {
+	if (k == pattern.npos)
 		k = pattern.size();
-		ret.go_back_before_replace = k - j;
-		if (ret.go_back_before_replace >= ret.count_matched)
-			return {}; // bad rule
-		return ret;
-	}
-	else {
-		ret.go_back_before_replace = k - j;
-		if (ret.go_back_before_replace >= ret.count_matched)
-			return {}; // bad rule
-	}
+	if (k - j >= count_matched)
+		return false;
+	r.go_back_before_replace = k - j;
 	j = k;
+	if (j == pattern.size())
+		return true;
 	if (pattern[j] >= '0' && pattern[j] <= '9') {
-		ret.priority = pattern[j] - '0';
+		r.priority = pattern[j] - '0';
 		++j;
 	}
-	if (j == pattern.size())
-		return ret;
-	if (pattern[j] == '^') {
-		if (!at_begin)
-			return {};
+	if (j != pattern.size() && pattern[j] == '^') {
+		r.at_begin_only = true;
 		++j;
 	}
-	if (j == pattern.size())
-		return ret;
-	if (pattern[j] == '^') {
-		ret.treat_next_as_begin = true;
+	if (j != pattern.size() && pattern[j] == '^') {
+		r.treat_next_as_begin = true;
 		++j;
 	}
 	if (j == pattern.size())
-		return ret;
+		return true;
+	// no other char is allowed at this point, the rest is ignored
 	if (pattern[j] != '$')
-		return {}; // bad rule, no other char is allowed at this point
-	if (i + ret.count_matched == data.size())
-		return ret;
-	return {};
+		return false;
+	r.at_end_only = true;
+	return true;
+}
+
+template <class CharT>
+auto Phonetic_Table<CharT>::match(const Str& data, size_t i, const Rule& r,
+                                  bool at_begin) -> bool
+{
+	if (r.at_begin_only && !at_begin)
+		return false;
+	auto n = r.literal.size();
+	if (data.size() - i < r.count_matched)
+		return false;
+	if (r.at_end_only && data.size() - i != r.count_matched)
+		return false;
+	if (data.compare(i, n, r.literal) != 0)
+		return false;
+	if (r.has_class && r.char_class.find(data[i + n]) == Str::npos)
+		return false;
+	return true;
 }
 
 template <class CharT>
@@ -2256,53 +2495,45 @@ auto Phonetic_Table<CharT>::replace(Str& word) const -> bool
 {
 	using boost::make_iterator_range;
 	struct Cmp {
-		auto operator()(CharT c, const Pair_Str& s)
-		{
-			return c < s.first[0];
-		}
-		auto operator()(const Pair_Str& s, CharT c)
-		{
-			return s.first[0] < c;
-		}
+		auto operator()(CharT c, const Rule& r) { return c < r.first; }
+		auto operator()(const Rule& r, CharT c) { return r.first < c; }
 	};
-	if (table.empty())
+	if (rules.empty())
 		return false;
 	auto ret = false;
 	auto treat_next_as_begin = true;
 	size_t count_go_backs_after_replace = 0; // avoid infinite loop
 	for (size_t i = 0; i != word.size(); ++i) {
-		auto rules =
-		    equal_range(begin(table), end(table), word[i], Cmp());
-		for (auto& r : make_iterator_range(rules)) {
+		auto candidates =
+		    equal_range(begin(rules), end(rules), word[i], Cmp());
+		for (auto& r : make_iterator_range(candidates)) {
 			auto rule = &r;
-			auto m1 = match(word, i, r.first, treat_next_as_begin);
-			if (!m1)
+			if (!match(word, i, r, treat_next_as_begin))
 				continue;
-			if (!m1.go_back_before_replace) {
-				auto j = i + m1.count_matched - 1;
+			if (!r.go_back_before_replace) {
+				auto j = i + r.count_matched - 1;
 				auto rules2 = equal_range(
-				    begin(table), end(table), word[j], Cmp());
+				    begin(rules), end(rules), word[j], Cmp());
 				for (auto& r2 : make_iterator_range(rules2)) {
-					auto m2 =
-					    match(word, j, r2.first, false);
-					if (m2 && m2.priority >= m1.priority) {
+					if (r2.priority >= r.priority &&
+					    match(word, j, r2, false)) {
 						i = j;
 						rule = &r2;
-						m1 = m2;
 						break;
 					}
 				}
 			}
-			word.replace(
-			    i, m1.count_matched - m1.go_back_before_replace,
-			    rule->second);
-			treat_next_as_begin = m1.treat_next_as_begin;
-			if (m1.go_back_after_replace &&
+			word.replace(i,
+			             rule->count_matched -
+			                 rule->go_back_before_replace,
+			             rule->replacement);
+			treat_next_as_begin = rule->treat_next_as_begin;
+			if (rule->go_back_after_replace &&
 			    count_go_backs_after_replace < 100) {
 				count_go_backs_after_replace++;
 			}
 			else {
-				i += rule->second.size();
+				i += rule->replacement.size();
 			}
 			--i;
 			ret = true;
@@ -17,7 +17,9 @@
  */
 
 #include "utils.hxx"
+#include "cpu_dispatch.hxx"
 
+#include <cstring>
 #include <limits>
 
 #include <boost/locale/utf8_codecvt.hpp>
@@ -47,8 +49,18 @@ using namespace std;
 
 enum class Utf_Error_Handling { ALWAYS_VALID, REPLACE, SKIP };
 
+/**
+ * @brief Converts between UTF encodings
+ *
+ * @param in input string
+ * @param out output string
+ * @param done length of the prefix of @p in that is already converted into
+ * the same length prefix of @p out, e.g. ASCII
+ * @return false if @p in is not valid
+ */
 template <Utf_Error_Handling eh, class InChar, class OutContainer>
-auto utf_to_utf(const std::basic_string<InChar>& in, OutContainer& out) -> bool
+auto utf_to_utf(const std::basic_string<InChar>& in, OutContainer& out,
+                size_t done = 0) -> bool
 {
 	using OutChar = typename OutContainer::value_type;
 	using namespace boost::locale::utf;
@@ -62,9 +74,9 @@ auto utf_to_utf(const std::basic_string<InChar>& in, OutContainer& out) -> bool
 	else
 		out.resize(in.size());
 
-	auto it = begin(in);
+	auto it = begin(in) + done;
 	auto last = end(in);
-	auto out_it = begin(out);
+	auto out_it = begin(out) + done;
 	auto out_last = end(out);
 	auto valid = true;
 	while (it != last) {
@@ -136,7 +148,13 @@ auto wide_to_utf8(const std::wstring& in) -> std::string
 
 auto utf8_to_wide(const std::string& in, std::wstring& out) -> bool
 {
-	return utf_to_utf_my(in, out);
+	// most words are ASCII, widen them with the vectorized kernel
+	out.resize(in.size());
+	auto& kernels = get_cpu_kernels();
+	auto n = kernels.widen_ascii(in.data(), in.size(), out.data());
+	if (n == in.size())
+		return true;
+	return utf_to_utf<Utf_Error_Handling::REPLACE>(in, out, n);
 }
 auto utf8_to_wide(const std::string& in) -> std::wstring
 {
@@ -547,4 +565,28 @@ auto count_appereances_of(const wstring& haystack, const wstring& needles)
 		return needles.find(c) != needles.npos;
 	});
 }
+
+/**
+ * @brief Fast non-cryptographic 64-bit hash of bytes, can be chained
+ */
+auto hash_bytes(string_view bytes, uint64_t h) -> uint64_t
+{
+	constexpr auto k = uint64_t(0x9E3779B97F4A7C15);
+	auto mix = [&](uint64_t x) {
+		h = (h ^ x) * k;
+		h ^= h >> 29;
+	};
+	mix(bytes.size());
+	size_t i = 0;
+	for (; i + 8 <= bytes.size(); i += 8) {
+		uint64_t x;
+		memcpy(&x, bytes.data() + i, 8);
+		mix(x);
+	}
+	uint64_t x = 0;
+	if (i != bytes.size()) // data() may be null for an empty view
+		memcpy(&x, bytes.data() + i, bytes.size() - i);
+	mix(x);
+	return h;
+}
 } // namespace nuspell
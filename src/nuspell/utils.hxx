@@ -28,6 +28,7 @@
 
 #include <locale>
 #include <clocale>
+#include <mutex>
 
 #if !defined(_WIN32) && (defined(__unix__) || defined(__unix) ||               \
                          (defined(__APPLE__) && defined(__MACH__)))
@@ -143,11 +144,23 @@ class Setlocale_To_C_In_Scope {
 	Setlocale_To_C_In_Scope(const Setlocale_To_C_In_Scope&) = delete;
 };
 #else
+// Without per-thread locales, setlocale() changes the locale of the whole
+// process. Dictionaries loaded in parallel, e.g. by load_many(), would
+// restore each other's saved locale, so the switch is serialized.
 class Setlocale_To_C_In_Scope {
-	std::string old_name;
 #ifdef _WIN32
 	int old_per_thread;
+#else
+	std::lock_guard<std::recursive_mutex> lock{get_mutex()};
 #endif
+	std::string old_name;
+
+	static auto get_mutex() -> std::recursive_mutex&
+	{
+		static auto mtx = std::recursive_mutex();
+		return mtx;
+	}
+
       public:
 	Setlocale_To_C_In_Scope() : old_name(setlocale(LC_ALL, nullptr))
 	{
@@ -278,5 +291,7 @@ auto is_number(const std::basic_string<CharT>& s) -> bool
 auto count_appereances_of(const std::wstring& haystack,
                           const std::wstring& needles) -> size_t;
 
+auto hash_bytes(std::string_view bytes, uint64_t h) -> uint64_t;
+
 } // namespace nuspell
 #endif // NUSPELL_UTILS_HXX
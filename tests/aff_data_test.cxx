@@ -20,6 +20,7 @@
 
 #include <catch2/catch.hpp>
 #include <iostream>
+#include <optional>
 #include <sstream>
 
 using namespace std;
@@ -180,3 +181,102 @@ SFX խխ 	0	ագ	.
 
 	cerr.rdbuf(old);
 }
+
+/**
+ * @brief Parses .aff and .dic, returns the errors and warnings printed.
+ */
+auto parse_aff_dic_errors(Aff_Data& aff_data, const string& aff,
+                          const string& dic) -> string
+{
+	auto cerr_buf = stringbuf();
+	auto old = cerr.rdbuf(&cerr_buf);
+	auto aff_in = istringstream(aff);
+	auto dic_in = istringstream(dic);
+	aff_data.parse_aff_dic(aff_in, dic_in);
+	cerr.rdbuf(old);
+	return cerr_buf.str();
+}
+
+auto get_flags(const Aff_Data& aff_data, const wstring& word)
+    -> optional<Flag_Set>
+{
+	auto r = aff_data.words.equal_range(word);
+	if (r.first == r.second)
+		return {};
+	return r.first->second;
+}
+
+TEST_CASE("Aff_Data::parse_dic() numeric flags")
+{
+	using namespace Catch::Matchers;
+	auto d = Aff_Data();
+	auto errors =
+	    parse_aff_dic_errors(d, "FLAG num\n",
+	                         "6\n"
+	                         "a/1,65535\n"
+	                         "b/65536\n"
+	                         "c/18446744073709551616\n"
+	                         "d/99999999999999999999999999999\n"
+	                         "e/x\n"
+	                         "f/7,\n");
+	CHECK(get_flags(d, L"a") == Flag_Set(u"\u0001\uFFFF"));
+	// too big, also when the number does not fit in size_t
+	CHECK_FALSE(get_flags(d, L"b"));
+	CHECK_FALSE(get_flags(d, L"c"));
+	CHECK_FALSE(get_flags(d, L"d"));
+	// no number, also after the comma
+	CHECK_FALSE(get_flags(d, L"e"));
+	CHECK_FALSE(get_flags(d, L"f"));
+	CHECK_THAT(errors, Contains("Flag above 65535 in line 3"));
+	CHECK_THAT(errors, Contains("Flag above 65535 in line 4"));
+	CHECK_THAT(errors, Contains("Flag above 65535 in line 5"));
+	CHECK_THAT(errors, Contains("invalid numerical flag"));
+}
+
+TEST_CASE("Aff_Data::parse_dic() flag aliases")
+{
+	auto d = Aff_Data();
+	auto errors = parse_aff_dic_errors(d, "AF 2\nAF BA\nAF C\n",
+	                                   "6\n"
+	                                   "a/1\n"
+	                                   "b/2\n"
+	                                   "c/0\n"
+	                                   "d/3\n"
+	                                   "e/18446744073709551617\n"
+	                                   "f/x\n");
+	CHECK(get_flags(d, L"a") == Flag_Set(u"AB"));
+	CHECK(get_flags(d, L"b") == Flag_Set(u"C"));
+	// aliases are counted from 1
+	CHECK_FALSE(get_flags(d, L"c"));
+	CHECK_FALSE(get_flags(d, L"d"));
+	// saturated, not wrapped around to alias 1
+	CHECK_FALSE(get_flags(d, L"e"));
+	CHECK_FALSE(get_flags(d, L"f"));
+	auto n = size_t(0);
+	for (auto pos = errors.find("Flag alias is invalid"); pos != errors.npos;
+	     pos = errors.find("Flag alias is invalid", pos + 1))
+		++n;
+	CHECK(n == 4);
+}
+
+TEST_CASE("Aff_Data::parse_dic() UTF-8 flags")
+{
+	using namespace Catch::Matchers;
+	auto d = Aff_Data();
+	auto errors = parse_aff_dic_errors(d, "SET UTF-8\nFLAG UTF-8\n",
+	                                   "5\n"
+	                                   "a/ab\n"
+	                                   "b/čж\n"
+	                                   "c/a\xC3\n"
+	                                   "d/\xE2\x82\n"
+	                                   "e/a\U0001F600\n");
+	CHECK(get_flags(d, L"a") == Flag_Set(u"ab"));
+	CHECK(get_flags(d, L"b") == Flag_Set(u"čж"));
+	CHECK_FALSE(get_flags(d, L"c"));
+	CHECK_FALSE(get_flags(d, L"d"));
+	// flags outside of the BMP do not fit in char16_t
+	CHECK_FALSE(get_flags(d, L"e"));
+	CHECK_THAT(errors, Contains("Invalid UTF-8 in flags in line 4"));
+	CHECK_THAT(errors, Contains("Invalid UTF-8 in flags in line 5"));
+	CHECK_THAT(errors, Contains("Flag above 65535 in line 6"));
+}
@@ -0,0 +1,21 @@
+# Runs the CLI tool with -l on a text and compares the misspelled words it
+# prints with the expected ones.
+#
+# Usage: cmake -DNUSPELL=exe -DDICTIONARY=path -DINPUT=file -DEXPECTED=file
+#              [-DOPTIONS=list] -P cli_test.cmake
+#
+# The encoding is given with -i, so the I/O locale is en_US.UTF-8 no matter
+# what the locale of the environment is.
+
+execute_process(
+    COMMAND "${NUSPELL}" -d "${DICTIONARY}" -i UTF-8 ${OPTIONS} -l "${INPUT}"
+    RESULT_VARIABLE result
+    OUTPUT_VARIABLE output
+    ERROR_VARIABLE errors)
+if (NOT result EQUAL 0)
+    message(FATAL_ERROR "nuspell failed with ${result}:\n${errors}")
+endif()
+file(READ "${EXPECTED}" expected)
+if (NOT output STREQUAL expected)
+    message(FATAL_ERROR "Expected:\n${expected}\nGot:\n${output}")
+endif()
@@ -19,6 +19,11 @@
 #include <nuspell/dictionary.hxx>
 
 #include <catch2/catch.hpp>
+#include <cstdio>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <thread>
 
 using namespace std;
 using namespace nuspell;
@@ -60,7 +65,8 @@ TEST_CASE("Dictionary::spell_priv suffixes", "[dictionary]")
 	d.words.emplace(L"May", u"T");
 	d.words.emplace(L"vary", u"");
 
-	d.suffixes = {{u'T', true, L"y", L"ies", Flag_Set(), L".[^aeiou]y"}};
+	d.edit_rules().suffixes = {
+	    {u'T', true, L"y", L"ies", Flag_Set(), L".[^aeiou]y"}};
 
 	auto good = {L"berry", L"Berry", L"berries", L"BERRIES",
 	             L"May",   L"MAY",   L"vary"};
@@ -77,8 +83,9 @@ TEST_CASE("Dictionary::spell_priv complex_prefixes", "[dictionary]")
 	auto d = Dict_Test();
 
 	d.words.emplace(L"drink", u"X");
-	d.suffixes = {{u'Y', true, L"", L"s", Flag_Set(), L"."},
-	              {u'X', true, L"", L"able", Flag_Set(u"Y"), L"."}};
+	d.edit_rules().suffixes = {
+	    {u'Y', true, L"", L"s", Flag_Set(), L"."},
+	    {u'X', true, L"", L"able", Flag_Set(u"Y"), L"."}};
 
 	auto good = {L"drink", L"drinkable", L"drinkables"};
 	for (auto& g : good)
@@ -98,18 +105,94 @@ TEST_CASE("Dictionary::spell_priv extra_stripping", "[dictionary]")
 	d.words.emplace(L"aa", u"ABC");
 	d.words.emplace(L"bb", u"XYZ");
 
-	d.prefixes = {{u'A', true, L"", L"W", Flag_Set(u"B"), L"aa"},
-	              {u'B', true, L"", L"Q", Flag_Set(u"C"), L"Wa"},
-	              {u'X', true, L"b", L"1", Flag_Set(u"Y"), L"b"},
-	              {u'Z', true, L"", L"3", Flag_Set(), L"1"}};
-	d.suffixes = {{u'C', true, L"", L"E", Flag_Set(), L"a"},
-	              {u'Y', true, L"", L"2", Flag_Set(u"Z"), L"b"}};
+	d.edit_rules().prefixes = {
+	    {u'A', true, L"", L"W", Flag_Set(u"B"), L"aa"},
+	    {u'B', true, L"", L"Q", Flag_Set(u"C"), L"Wa"},
+	    {u'X', true, L"b", L"1", Flag_Set(u"Y"), L"b"},
+	    {u'Z', true, L"", L"3", Flag_Set(), L"1"}};
+	d.edit_rules().suffixes = {
+	    {u'C', true, L"", L"E", Flag_Set(), L"a"},
+	    {u'Y', true, L"", L"2", Flag_Set(u"Z"), L"b"}};
 	// complex strip suffix prefix prefix
 	CHECK(d.spell_priv(L"QWaaE") == true);
 	// complex strip prefix suffix prefix
 	CHECK(d.spell_priv(L"31b2") == true);
 }
 
+TEST_CASE("Dictionary::stem_priv", "[dictionary]")
+{
+	auto d = Dict_Test();
+
+	d.words.emplace(L"draw", u"G");
+	d.words.emplace(L"drawing", u"S");
+	d.words.emplace(L"drawn", u"");
+	d.edit_rules().suffixes = {
+	    {u'S', true, L"", L"s", Flag_Set(), L"."},
+	    {u'G', true, L"", L"ing", Flag_Set(u"S"), L"."}};
+
+	auto w = wstring(L"drawings");
+	auto out = List_WStrings();
+	auto expected = List_WStrings{L"drawing", L"draw"};
+	d.stem_priv(w, out);
+	CHECK(out == expected);
+	CHECK(w == L"drawings");
+
+	w = L"DRAWINGS";
+	out.clear();
+	d.stem_priv(w, out);
+	CHECK(out == expected);
+
+	w = L"drawn";
+	out.clear();
+	expected = {L"drawn"};
+	d.stem_priv(w, out);
+	CHECK(out == expected);
+
+	w = L"drawns";
+	out.clear();
+	d.stem_priv(w, out);
+	CHECK(out.empty());
+}
+
+TEST_CASE("Dictionary::analyze", "[dictionary]")
+{
+	auto aff = istringstream(R"(SET UTF-8
+AM 2
+AM po:noun
+AM po:verb
+SFX S Y 1
+SFX S 0 s . is:plural
+SFX G Y 1
+SFX G 0 ing/S . ds:ing
+PFX R Y 1
+PFX R 0 re . dp:re
+)");
+	auto dic = istringstream(R"(3
+draw/GR	2
+drawing/S 1
+walk/S po:verb   al:walked
+)");
+	auto d = Dictionary::load_from_aff_dic(aff, dic);
+	auto out = vector<string>();
+	d.analyze("drawings", out);
+	CHECK(out == vector<string>{"st:drawing po:noun is:plural",
+	                            "st:draw po:verb ds:ing is:plural"});
+	d.analyze("walks", out);
+	CHECK(out == vector<string>{"st:walk po:verb al:walked is:plural"});
+	d.analyze("walking", out);
+	CHECK(out.empty());
+	d.stem("Drawings", out);
+	CHECK(out == vector<string>{"drawing", "draw"});
+
+	// one prefix and two suffixes
+	CHECK(d.spell("redrawings"));
+	d.stem("redrawings", out);
+	CHECK(out == vector<string>{"draw"});
+	d.analyze("redrawings", out);
+	CHECK(out ==
+	      vector<string>{"dp:re st:draw po:verb ds:ing is:plural"});
+}
+
 TEST_CASE("Dictionary::spell_priv break_pattern", "[dictionary]")
 {
 	auto d = Dict_Test();
@@ -189,6 +272,32 @@ TEST_CASE("Dictionary::spell_priv compounding compound_middle", "[dictionary]")
 		CHECK(d.spell_priv(w) == false);
 }
 
+TEST_CASE("Dictionary::spell_priv compounding rules", "[dictionary]")
+{
+	// words that are not loaded from a .dic take part in the rules too
+	auto d = Dict_Test();
+	d.compound_rules = {u"A*B"};
+	d.words.emplace(L"one", u"A");
+	d.words.emplace(L"two", u"B");
+	d.words.emplace(L"six", u"X");
+
+	CHECK(d.spell_priv(L"onetwo") == true);
+	CHECK(d.spell_priv(L"oneonetwo") == true);
+	CHECK(d.spell_priv(L"twoone") == false);
+	CHECK(d.spell_priv(L"onesix") == false);
+
+	// all flag values are usable in the rules
+	auto aff = istringstream("FLAG num\n"
+	                         "COMPOUNDMIN 1\n"
+	                         "COMPOUNDRULE 1\n"
+	                         "COMPOUNDRULE (65534)(1)\n");
+	auto dic = istringstream("3\nfoo/65534\nbar/1\nbaz/65533\n");
+	auto d2 = Dictionary::load_from_aff_dic(aff, dic);
+	CHECK(d2.spell("foobar"));
+	CHECK_FALSE(d2.spell("bazbar"));
+	CHECK_FALSE(d2.spell("barfoo"));
+}
+
 TEST_CASE("Dictionary::spell_priv compounding triple", "[dictionary]")
 {
 	auto d = Dict_Test();
@@ -212,10 +321,10 @@ TEST_CASE("Dictionary suggestions rep_suggest", "[dictionary]")
 {
 	auto d = Dict_Test();
 
-	d.replacements = {{L"ph", L"f"},
-	                  {L"shun$", L"tion"},
-	                  {L"^voo", L"foo"},
-	                  {L"^alot$", L"a lot"}};
+	d.edit_rules().replacements = {{L"ph", L"f"},
+	                               {L"shun$", L"tion"},
+	                               {L"^voo", L"foo"},
+	                               {L"^alot$", L"a lot"}};
 	auto good = L"fat";
 	d.words.emplace(L"fat", u"");
 	CHECK(d.spell_priv(good) == true);
@@ -324,7 +433,7 @@ TEST_CASE("Dictionary suggestions map_suggest", "[dictionary]")
 
 	auto good = L"naïve";
 	d.words.emplace(L"naïve", u"");
-	d.similarities = {Similarity_Group<wchar_t>(L"iíìîï")};
+	d.edit_rules().similarities = {Similarity_Group<wchar_t>(L"iíìîï")};
 	CHECK(d.spell_priv(good) == true);
 
 	auto w = wstring(L"naive");
@@ -336,7 +445,8 @@ TEST_CASE("Dictionary suggestions map_suggest", "[dictionary]")
 	CHECK(out_sug == expected_sug);
 
 	d.words.emplace(L"æon", u"");
-	d.similarities.push_back(Similarity_Group<wchar_t>(L"æ(ae)"));
+	d.edit_rules().similarities.push_back(
+	    Similarity_Group<wchar_t>(L"æ(ae)"));
 	good = L"æon";
 	CHECK(d.spell_priv(good) == true);
 	w = wstring(L"aeon");
@@ -347,7 +457,8 @@ TEST_CASE("Dictionary suggestions map_suggest", "[dictionary]")
 	CHECK(out_sug == expected_sug);
 
 	d.words.emplace(L"zijn", u"");
-	d.similarities.push_back(Similarity_Group<wchar_t>(L"(ij)ĳ"));
+	d.edit_rules().similarities.push_back(
+	    Similarity_Group<wchar_t>(L"(ij)ĳ"));
 	good = L"zijn";
 	CHECK(d.spell_priv(good) == true);
 	w = wstring(L"zĳn");
@@ -358,7 +469,8 @@ TEST_CASE("Dictionary suggestions map_suggest", "[dictionary]")
 	CHECK(out_sug == expected_sug);
 
 	d.words.emplace(L"hear", u"");
-	d.similarities.push_back(Similarity_Group<wchar_t>(L"(ae)(ea)"));
+	d.edit_rules().similarities.push_back(
+	    Similarity_Group<wchar_t>(L"(ae)(ea)"));
 	good = L"hear";
 	CHECK(d.spell_priv(good) == true);
 	w = wstring(L"haer");
@@ -466,111 +578,111 @@ TEST_CASE("Dictionary suggestions phonetic_suggest", "[dictionary]")
 	// its morph data, but this is pending enabling of
 	// parse_morhological_fields when reading aff file.
 
-	d.phonetic_table = {{L"AH(AEIOUY)-^", L"*H"},
-	                                    {L"AR(AEIOUY)-^", L"*R"},
-	                                    {L"A(HR)^", L"*"},
-	                                    {L"A^", L"*"},
-	                                    {L"AH(AEIOUY)-", L"H"},
-	                                    {L"AR(AEIOUY)-", L"R"},
-	                                    {L"A(HR)", L"_"},
-	                                    {L"BB-", L"_"},
-	                                    {L"B", L"B"},
-	                                    {L"CQ-", L"_"},
-	                                    {L"CIA", L"X"},
-	                                    {L"CH", L"X"},
-	                                    {L"C(EIY)-", L"S"},
-	                                    {L"CK", L"K"},
-	                                    {L"COUGH^", L"KF"},
-	                                    {L"CC<", L"C"},
-	                                    {L"C", L"K"},
-	                                    {L"DG(EIY)", L"K"},
-	                                    {L"DD-", L"_"},
-	                                    {L"D", L"T"},
-	                                    {L"É<", L"E"},
-	                                    {L"EH(AEIOUY)-^", L"*H"},
-	                                    {L"ER(AEIOUY)-^", L"*R"},
-	                                    {L"E(HR)^", L"*"},
-	                                    {L"ENOUGH^$", L"*NF"},
-	                                    {L"E^", L"*"},
-	                                    {L"EH(AEIOUY)-", L"H"},
-	                                    {L"ER(AEIOUY)-", L"R"},
-	                                    {L"E(HR)", L"_"},
-	                                    {L"FF-", L"_"},
-	                                    {L"F", L"F"},
-	                                    {L"GN^", L"N"},
-	                                    {L"GN$", L"N"},
-	                                    {L"GNS$", L"NS"},
-	                                    {L"GNED$", L"N"},
-	                                    {L"GH(AEIOUY)-", L"K"},
-	                                    {L"GH", L"_"},
-	                                    {L"GG9", L"K"},
-	                                    {L"G", L"K"},
-	                                    {L"H", L"H"},
-	                                    {L"IH(AEIOUY)-^", L"*H"},
-	                                    {L"IR(AEIOUY)-^", L"*R"},
-	                                    {L"I(HR)^", L"*"},
-	                                    {L"I^", L"*"},
-	                                    {L"ING6", L"N"},
-	                                    {L"IH(AEIOUY)-", L"H"},
-	                                    {L"IR(AEIOUY)-", L"R"},
-	                                    {L"I(HR)", L"_"},
-	                                    {L"J", L"K"},
-	                                    {L"KN^", L"N"},
-	                                    {L"KK-", L"_"},
-	                                    {L"K", L"K"},
-	                                    {L"LAUGH^", L"LF"},
-	                                    {L"LL-", L"_"},
-	                                    {L"L", L"L"},
-	                                    {L"MB$", L"M"},
-	                                    {L"MM", L"M"},
-	                                    {L"M", L"M"},
-	                                    {L"NN-", L"_"},
-	                                    {L"N", L"N"},
-	                                    {L"OH(AEIOUY)-^", L"*H"},
-	                                    {L"OR(AEIOUY)-^", L"*R"},
-	                                    {L"O(HR)^", L"*"},
-	                                    {L"O^", L"*"},
-	                                    {L"OH(AEIOUY)-", L"H"},
-	                                    {L"OR(AEIOUY)-", L"R"},
-	                                    {L"O(HR)", L"_"},
-	                                    {L"PH", L"F"},
-	                                    {L"PN^", L"N"},
-	                                    {L"PP-", L"_"},
-	                                    {L"P", L"P"},
-	                                    {L"Q", L"K"},
-	                                    {L"RH^", L"R"},
-	                                    {L"ROUGH^", L"RF"},
-	                                    {L"RR-", L"_"},
-	                                    {L"R", L"R"},
-	                                    {L"SCH(EOU)-", L"SK"},
-	                                    {L"SC(IEY)-", L"S"},
-	                                    {L"SH", L"X"},
-	                                    {L"SI(AO)-", L"X"},
-	                                    {L"SS-", L"_"},
-	                                    {L"S", L"S"},
-	                                    {L"TI(AO)-", L"X"},
-	                                    {L"TH", L"@"},
-	                                    {L"TCH--", L"_"},
-	                                    {L"TOUGH^", L"TF"},
-	                                    {L"TT-", L"_"},
-	                                    {L"T", L"T"},
-	                                    {L"UH(AEIOUY)-^", L"*H"},
-	                                    {L"UR(AEIOUY)-^", L"*R"},
-	                                    {L"U(HR)^", L"*"},
-	                                    {L"U^", L"*"},
-	                                    {L"UH(AEIOUY)-", L"H"},
-	                                    {L"UR(AEIOUY)-", L"R"},
-	                                    {L"U(HR)", L"_"},
-	                                    {L"V^", L"W"},
-	                                    {L"V", L"F"},
-	                                    {L"WR^", L"R"},
-	                                    {L"WH^", L"W"},
-	                                    {L"W(AEIOU)-", L"W"},
-	                                    {L"X^", L"S"},
-	                                    {L"X", L"KS"},
-	                                    {L"Y(AEIOU)-", L"Y"},
-	                                    {L"ZZ-", L"_"},
-	                                    {L"Z", L"S"}};
+	d.edit_rules().phonetic_table = {{L"AH(AEIOUY)-^", L"*H"},
+	                                 {L"AR(AEIOUY)-^", L"*R"},
+	                                 {L"A(HR)^", L"*"},
+	                                 {L"A^", L"*"},
+	                                 {L"AH(AEIOUY)-", L"H"},
+	                                 {L"AR(AEIOUY)-", L"R"},
+	                                 {L"A(HR)", L"_"},
+	                                 {L"BB-", L"_"},
+	                                 {L"B", L"B"},
+	                                 {L"CQ-", L"_"},
+	                                 {L"CIA", L"X"},
+	                                 {L"CH", L"X"},
+	                                 {L"C(EIY)-", L"S"},
+	                                 {L"CK", L"K"},
+	                                 {L"COUGH^", L"KF"},
+	                                 {L"CC<", L"C"},
+	                                 {L"C", L"K"},
+	                                 {L"DG(EIY)", L"K"},
+	                                 {L"DD-", L"_"},
+	                                 {L"D", L"T"},
+	                                 {L"É<", L"E"},
+	                                 {L"EH(AEIOUY)-^", L"*H"},
+	                                 {L"ER(AEIOUY)-^", L"*R"},
+	                                 {L"E(HR)^", L"*"},
+	                                 {L"ENOUGH^$", L"*NF"},
+	                                 {L"E^", L"*"},
+	                                 {L"EH(AEIOUY)-", L"H"},
+	                                 {L"ER(AEIOUY)-", L"R"},
+	                                 {L"E(HR)", L"_"},
+	                                 {L"FF-", L"_"},
+	                                 {L"F", L"F"},
+	                                 {L"GN^", L"N"},
+	                                 {L"GN$", L"N"},
+	                                 {L"GNS$", L"NS"},
+	                                 {L"GNED$", L"N"},
+	                                 {L"GH(AEIOUY)-", L"K"},
+	                                 {L"GH", L"_"},
+	                                 {L"GG9", L"K"},
+	                                 {L"G", L"K"},
+	                                 {L"H", L"H"},
+	                                 {L"IH(AEIOUY)-^", L"*H"},
+	                                 {L"IR(AEIOUY)-^", L"*R"},
+	                                 {L"I(HR)^", L"*"},
+	                                 {L"I^", L"*"},
+	                                 {L"ING6", L"N"},
+	                                 {L"IH(AEIOUY)-", L"H"},
+	                                 {L"IR(AEIOUY)-", L"R"},
+	                                 {L"I(HR)", L"_"},
+	                                 {L"J", L"K"},
+	                                 {L"KN^", L"N"},
+	                                 {L"KK-", L"_"},
+	                                 {L"K", L"K"},
+	                                 {L"LAUGH^", L"LF"},
+	                                 {L"LL-", L"_"},
+	                                 {L"L", L"L"},
+	                                 {L"MB$", L"M"},
+	                                 {L"MM", L"M"},
+	                                 {L"M", L"M"},
+	                                 {L"NN-", L"_"},
+	                                 {L"N", L"N"},
+	                                 {L"OH(AEIOUY)-^", L"*H"},
+	                                 {L"OR(AEIOUY)-^", L"*R"},
+	                                 {L"O(HR)^", L"*"},
+	                                 {L"O^", L"*"},
+	                                 {L"OH(AEIOUY)-", L"H"},
+	                                 {L"OR(AEIOUY)-", L"R"},
+	                                 {L"O(HR)", L"_"},
+	                                 {L"PH", L"F"},
+	                                 {L"PN^", L"N"},
+	                                 {L"PP-", L"_"},
+	                                 {L"P", L"P"},
+	                                 {L"Q", L"K"},
+	                                 {L"RH^", L"R"},
+	                                 {L"ROUGH^", L"RF"},
+	                                 {L"RR-", L"_"},
+	                                 {L"R", L"R"},
+	                                 {L"SCH(EOU)-", L"SK"},
+	                                 {L"SC(IEY)-", L"S"},
+	                                 {L"SH", L"X"},
+	                                 {L"SI(AO)-", L"X"},
+	                                 {L"SS-", L"_"},
+	                                 {L"S", L"S"},
+	                                 {L"TI(AO)-", L"X"},
+	                                 {L"TH", L"@"},
+	                                 {L"TCH--", L"_"},
+	                                 {L"TOUGH^", L"TF"},
+	                                 {L"TT-", L"_"},
+	                                 {L"T", L"T"},
+	                                 {L"UH(AEIOUY)-^", L"*H"},
+	                                 {L"UR(AEIOUY)-^", L"*R"},
+	                                 {L"U(HR)^", L"*"},
+	                                 {L"U^", L"*"},
+	                                 {L"UH(AEIOUY)-", L"H"},
+	                                 {L"UR(AEIOUY)-", L"R"},
+	                                 {L"U(HR)", L"_"},
+	                                 {L"V^", L"W"},
+	                                 {L"V", L"F"},
+	                                 {L"WR^", L"R"},
+	                                 {L"WH^", L"W"},
+	                                 {L"W(AEIOU)-", L"W"},
+	                                 {L"X^", L"S"},
+	                                 {L"X", L"KS"},
+	                                 {L"Y(AEIOU)-", L"Y"},
+	                                 {L"ZZ-", L"_"},
+	                                 {L"Z", L"S"}};
 
 	auto w = wstring(L"Brasillian");
 	CHECK(d.spell_priv(w) == false);
@@ -641,10 +753,10 @@ TEST_CASE("suggest_priv_max", "[dictionary]")
 {
 	auto d = Dict_Test();
 
-	d.replacements = {
+	d.edit_rules().replacements = {
 	    {L"x", L"a"}, {L"x", L"b"}, {L"x", L"c"}, {L"x", L"d"},
 	    {L"x", L"e"}, {L"x", L"f"}, {L"x", L"g"}, {L"x", L"h"}};
-	d.similarities = {
+	d.edit_rules().similarities = {
 	    Similarity_Group<wchar_t>(L"xabcdefgh")};
 	d.keyboard_closeness = L"axb|cxd|exf|gxh";
 	d.try_chars = L"abcdefgh";
@@ -675,3 +787,550 @@ TEST_CASE("suggest_priv_max", "[dictionary]")
 	CHECK(d.words.size() == out_sug.size());
 }
 #endif
+
+TEST_CASE("Dictionary::suggest into Suggestion_List", "[dictionary]")
+{
+	auto aff = istringstream("SET UTF-8\nTRY ailrtbe\n");
+	auto dic = istringstream("3\ntral\ntrial\ntrail\n");
+	auto d = Dictionary::load_from_aff_dic(aff, dic);
+
+	auto expected = vector<string>();
+	d.suggest("traal", expected);
+	REQUIRE(!expected.empty());
+
+	auto sugs = Suggestion_List();
+	sugs.push_back("dummy");
+	d.suggest("traal", sugs);
+	REQUIRE(sugs.size() == expected.size());
+	for (size_t i = 0; i != sugs.size(); ++i)
+		CHECK(sugs[i] == expected[i]);
+
+	d.suggest("qqqqqq", sugs);
+	CHECK(sugs.empty());
+	d.suggest("traal", sugs);
+	CHECK(sugs.size() == expected.size());
+	d.suggest(string(200, 'a'), sugs);
+	CHECK(sugs.empty());
+
+	// a moved-from list is empty and can be reused
+	d.suggest("traal", sugs);
+	auto sugs2 = std::move(sugs);
+	CHECK(sugs2.size() == expected.size());
+	CHECK(sugs2[0] == expected[0]);
+	CHECK(sugs.size() == 0);
+	CHECK(sugs.empty());
+	sugs.push_back("ab");
+	sugs.push_back("");
+	sugs.push_back("c");
+	REQUIRE(sugs.size() == 3);
+	CHECK(sugs[0] == "ab");
+	CHECK(sugs[1] == "");
+	CHECK(sugs[2] == "c");
+	sugs = std::move(sugs2);
+	CHECK(sugs.size() == expected.size());
+}
+
+TEST_CASE("Dictionary::suggest hyphenated words", "[dictionary]")
+{
+	auto aff = istringstream("SET UTF-8\nTRY elmaiwnkow\n");
+	auto dic = istringstream("4\ne\nmail\nwell\nknown\n");
+	auto d = Dictionary::load_from_aff_dic(aff, dic);
+
+	auto sugs = vector<string>();
+	auto usage = get_cache_usage();
+	d.suggest("e-mial", sugs);
+	CHECK(sugs == vector<string>{"e-mail"});
+	CHECK(get_cache_usage() > usage);
+	d.suggest("e-mial", sugs);
+	CHECK(sugs == vector<string>{"e-mail"});
+
+	// two misspelled segments, each is corrected on its own
+	d.suggest("wel-knwn", sugs);
+	CHECK(find(begin(sugs), end(sugs), "well-knwn") != end(sugs));
+	CHECK(find(begin(sugs), end(sugs), "wel-known") != end(sugs));
+	CHECK(find(begin(sugs), end(sugs), "wel-well") == end(sugs));
+	auto again = vector<string>();
+	d.suggest("wel-knwn", again);
+	CHECK(again == sugs);
+
+	d.trim(Trim_Level::CACHES);
+	d.suggest("wel-knwn", again);
+	CHECK(again == sugs);
+
+	// the segments run on the executor of suggest_async()
+	d.trim(Trim_Level::CACHES);
+	auto num_tasks = 0;
+	auto inline_executor = Function_Executor(
+	    [&](function<void()> task) {
+		    ++num_tasks;
+		    task();
+	    },
+	    2);
+	d.suggest_async(
+	    "wel-knwn", [&](vector<string>& s) { again = move(s); },
+	    [](exception_ptr) { FAIL("suggest_async() failed"); },
+	    inline_executor);
+	CHECK(again == sugs);
+	CHECK(num_tasks == 2);
+}
+
+TEST_CASE("Dictionary::suggest_async", "[dictionary]")
+{
+	auto aff = istringstream("SET UTF-8\nTRY ailrtbe\n");
+	auto dic = istringstream("3\ntral\ntrial\ntrail\n");
+	auto d = Dictionary::load_from_aff_dic(aff, dic);
+
+	auto expected = vector<string>();
+	d.suggest("traal", expected);
+	REQUIRE(!expected.empty());
+	auto fut = d.suggest_async("traal");
+	CHECK(fut.get() == expected);
+
+	auto tasks = vector<function<void()>>();
+	auto deferred = Function_Executor(
+	    [&](function<void()> task) { tasks.push_back(move(task)); }, 1);
+	auto sugs = vector<string>{"dummy"};
+	auto num_calls = 0;
+	auto num_errors = 0;
+	d.suggest_async(
+	    "traal",
+	    [&](vector<string>& s) {
+		    sugs = move(s);
+		    ++num_calls;
+	    },
+	    [&](exception_ptr) { ++num_errors; }, deferred);
+	CHECK(num_calls == 0);
+	REQUIRE(tasks.size() == 1);
+	tasks[0]();
+	CHECK(num_calls == 1);
+	CHECK(num_errors == 0);
+	CHECK(sugs == expected);
+
+	// errors can not be thrown to the executor, so they must be handled
+	auto no_error_handler = Dictionary::Error_Callback();
+	CHECK_THROWS_AS(d.suggest_async(
+	                    "traal", [](vector<string>&) {}, no_error_handler,
+	                    deferred),
+	                invalid_argument);
+	CHECK(tasks.size() == 1);
+
+	auto token = Cancellation_Token();
+	token.cancel();
+	fut = d.suggest_async("traal", default_executor(), token);
+	CHECK(fut.get().empty());
+}
+
+TEST_CASE("Thread_Pool_Executor catches exceptions of tasks",
+          "[dictionary]")
+{
+	auto errors = vector<string>();
+	auto num_run = 0;
+	{
+		auto pool = Thread_Pool_Executor(1, [&](exception_ptr e) {
+			try {
+				rethrow_exception(e);
+			}
+			catch (const runtime_error& ex) {
+				errors.push_back(ex.what());
+			}
+		});
+		pool.execute([] { throw runtime_error("task failed"); });
+		pool.execute([&] { ++num_run; });
+	} // the destructor runs the remaining tasks
+	CHECK(errors == vector<string>{"task failed"});
+	CHECK(num_run == 1);
+}
+
+TEST_CASE("Dictionary::suggest_batch", "[dictionary]")
+{
+	auto aff = istringstream("SET UTF-8\nTRY ailrtbe\n");
+	auto dic = istringstream("5\ntral\ntrial\ntrail\ntraalt\ntable\n");
+	auto d = Dictionary::load_from_aff_dic(aff, dic);
+
+	auto words = vector<string>{"traal", "tabel", "traal", "trail", "xyz"};
+	auto expected = vector<vector<string>>(words.size());
+	for (size_t i = 0; i != words.size(); ++i)
+		d.suggest(words[i], expected[i]);
+
+	for (size_t num_threads : {1, 2, 8}) {
+		auto pool = Thread_Pool_Executor(num_threads);
+		auto results = vector<vector<string>>(words.size());
+		auto num_calls = vector<int>(words.size());
+		d.suggest_batch(
+		    words,
+		    [&](size_t i, const vector<string>& sugs) {
+			    results[i] = sugs;
+			    ++num_calls[i];
+		    },
+		    pool);
+		CHECK(results == expected);
+		CHECK(num_calls == vector<int>(words.size(), 1));
+	}
+
+	auto throwing = [](size_t, const vector<string>&) {
+		throw runtime_error("stop");
+	};
+	CHECK_THROWS_AS(d.suggest_batch(words, throwing), runtime_error);
+
+	auto token = Cancellation_Token();
+	auto num_calls = 0;
+	d.suggest_batch(
+	    words,
+	    [&](size_t, const vector<string>&) {
+		    ++num_calls;
+		    token.cancel();
+	    },
+	    default_executor(), token);
+	CHECK(token.is_cancelled());
+	CHECK(num_calls <= 2); // only the first group, "traal" is twice
+
+	// a user-supplied executor that runs each task on a new thread
+	auto threads = vector<thread>();
+	auto adapter = Function_Executor(
+	    [&](function<void()> task) { threads.emplace_back(move(task)); },
+	    4);
+	auto results = vector<vector<string>>(words.size());
+	d.suggest_batch(words, [&](size_t i, const vector<string>& sugs) {
+		results[i] = sugs;
+	}, adapter);
+	for (auto& t : threads)
+		t.join();
+	CHECK(results == expected);
+}
+
+TEST_CASE("Identifier_Checker", "[dictionary]")
+{
+	using Sw = Identifier_Checker::Subword;
+	auto sws = vector<Sw>();
+	Identifier_Checker::split("parseHttpResponse", sws);
+	CHECK(sws == vector<Sw>{{0, 5}, {5, 4}, {9, 8}});
+	Identifier_Checker::split("max_buffer_len2", sws);
+	CHECK(sws == vector<Sw>{{0, 3}, {4, 6}, {11, 3}});
+	Identifier_Checker::split("HTTPResponse", sws);
+	CHECK(sws == vector<Sw>{{0, 4}, {4, 8}});
+	Identifier_Checker::split("utf8ToUTF16", sws);
+	CHECK(sws == vector<Sw>{{0, 3}, {4, 2}, {6, 3}});
+	Identifier_Checker::split("getX", sws);
+	CHECK(sws == vector<Sw>{{0, 3}});
+	Identifier_Checker::split("ABc", sws);
+	CHECK(sws == vector<Sw>{{1, 2}});
+	Identifier_Checker::split("aBCd", sws);
+	CHECK(sws == vector<Sw>{{2, 2}});
+	Identifier_Checker::split("__", sws);
+	CHECK(sws.empty());
+
+	auto aff = istringstream("SET UTF-8\n");
+	auto dic = istringstream("4\nparse\nresponse\nmax\nbuffer\n");
+	auto d = Dictionary::load_from_aff_dic(aff, dic);
+	auto checker = Identifier_Checker(d);
+	auto wrong = vector<Sw>();
+	CHECK(checker.check("parseResponse", wrong));
+	CHECK(wrong.empty());
+	CHECK(!checker.check("parseHttpResponse", wrong));
+	CHECK(wrong == vector<Sw>{{5, 4}});
+	CHECK(!checker.check("max_bufer_len", wrong));
+	CHECK(wrong == vector<Sw>{{4, 5}, {10, 3}});
+	CHECK(checker.cache_size() == 6);
+	checker.clear_cache();
+	CHECK(checker.cache_size() == 0);
+}
+
+TEST_CASE("Dictionary::trim", "[dictionary]")
+{
+	auto aff = istringstream("SET UTF-8\nTRY ailrtbe\n");
+	auto dic = istringstream("1000\ntral\ntrial\ntrail\n");
+	auto d = Dictionary::load_from_aff_dic(aff, dic);
+	auto sugs = vector<string>();
+	d.suggest("traal", sugs);
+	auto expected = sugs;
+	for (auto level :
+	     {Trim_Level::SCRATCH, Trim_Level::CACHES, Trim_Level::ALL}) {
+		d.trim(level);
+		CHECK(d.spell("trial"));
+		CHECK(!d.spell("traal"));
+		d.suggest("traal", sugs);
+		CHECK(sugs == expected);
+	}
+
+	auto old_budget = get_cache_budget();
+	auto checker = Identifier_Checker(d);
+	auto usage = get_cache_usage();
+	checker.spell_subword("trial");
+	CHECK(checker.cache_size() == 1);
+	CHECK(get_cache_usage() > usage);
+	d.trim(Trim_Level::CACHES);
+	checker.spell_subword("trail");
+	CHECK(checker.cache_size() == 1);
+
+	set_cache_budget(get_cache_usage());
+	CHECK(checker.spell_subword("tral"));
+	CHECK(checker.cache_size() == 1);
+	set_cache_budget(old_budget);
+	checker.clear_cache();
+	CHECK(get_cache_usage() == usage);
+}
+
+TEST_CASE("Aff_Rules are shared between dictionaries", "[dictionary]")
+{
+	auto aff_text =
+	    string("SET UTF-8\nSFX A Y 1\nSFX A 0 s .\nREP 1\nREP f ph\n");
+	auto aff1 = istringstream(aff_text);
+	auto dic1 = istringstream("1\ncat/A\n");
+	auto d1 = Dict_Test();
+	d1.parse_aff_dic(aff1, dic1);
+	auto aff2 = istringstream(aff_text);
+	auto dic2 = istringstream("1\ndog/A\n");
+	auto d2 = Dict_Test();
+	d2.parse_aff_dic(aff2, dic2);
+	CHECK(d1.rules == d2.rules);
+	CHECK(d1.spell_priv(L"cats"));
+	CHECK(d2.spell_priv(L"dogs"));
+
+	auto aff3 = istringstream(aff_text + "TRY abc\n");
+	auto dic3 = istringstream("1\ncat/A\n");
+	auto d3 = Dict_Test();
+	d3.parse_aff_dic(aff3, dic3);
+	CHECK(d1.rules != d3.rules);
+
+	// editing makes a private copy
+	d2.edit_rules().suffixes = Suffix_Table();
+	CHECK(d1.rules != d2.rules);
+	CHECK(d1.spell_priv(L"cats"));
+	CHECK_FALSE(d2.spell_priv(L"dogs"));
+
+	// editing the only owner unregisters the rules before changing them
+	d1.edit_rules().suffixes = Suffix_Table();
+	d3.edit_rules().suffixes = Suffix_Table();
+	auto aff4 = istringstream(aff_text);
+	auto dic4 = istringstream("1\ncat/A\n");
+	auto d4 = Dict_Test();
+	d4.parse_aff_dic(aff4, dic4);
+	CHECK(d4.rules != d1.rules);
+	CHECK(d4.spell_priv(L"cats"));
+}
+
+TEST_CASE("Dictionary::spell work is limited", "[dictionary]")
+{
+	// Compound rules with stars and BREAK make the search exponential in
+	// the length of the word.
+	auto aff = istringstream("COMPOUNDMIN 1\n"
+	                         "COMPOUNDRULE 2\n"
+	                         "COMPOUNDRULE A*A\n"
+	                         "COMPOUNDRULE A*AAB*BBBC*C\n"
+	                         "BREAK 2\n"
+	                         "BREAK -\n"
+	                         "BREAK b\n");
+	auto dic = istringstream("3\na/A\nb/B\nc/C\n");
+	auto d = Dictionary::load_from_aff_dic(aff, dic);
+	auto work = Spell_Work();
+	CHECK(d.spell("aaabbbccc", work));
+	CHECK_FALSE(work.exhausted);
+	CHECK(work.probes < 1000);
+
+	// fuzzing with a fixed seed, words up to the length limit of 180
+	auto rng = minstd_rand(42);
+	auto alphabet = string("abc-SX");
+	auto max_probes = size_t(0);
+	auto max_splits = size_t(0);
+	for (auto i = 0; i != 300; ++i) {
+		auto word = string(rng() % 180 + 1, ' ');
+		for (auto& c : word)
+			c = alphabet[rng() % (i % 2 ? 3 : alphabet.size())];
+		auto res = d.spell(word, work);
+		CHECK(work.probes <= Dictionary::DEFAULT_MAX_SPELL_PROBES);
+		CHECK(work.splits <= Dictionary::DEFAULT_MAX_SPELL_SPLITS);
+		if (work.exhausted)
+			CHECK_FALSE(res);
+		max_probes = max(max_probes, work.probes);
+		max_splits = max(max_splits, work.splits);
+	}
+	// the fuzzing reached the limit, so it actually tested the bounds
+	CHECK(max_splits == Dictionary::DEFAULT_MAX_SPELL_SPLITS);
+
+	// when a limit is reached the word is rejected
+	d.set_spell_limits(20, 1000);
+	CHECK_FALSE(d.spell("aaaaaaaaaaaaaaaaaaaabbbbbbbbbbbbbbbbcccc", work));
+	CHECK(work.exhausted);
+	CHECK(work.probes == 20);
+	d.set_spell_limits(1000, 3);
+	CHECK_FALSE(d.spell("aaaaaaaaaaaaaaaaaaaabbbbbbbbbbbbbbbbcccc", work));
+	CHECK(work.exhausted);
+	CHECK(work.splits == 3);
+	d.set_spell_limits(Dictionary::DEFAULT_MAX_SPELL_PROBES,
+	                   Dictionary::DEFAULT_MAX_SPELL_SPLITS);
+	CHECK(d.spell("aaaaaaaaaaaaaaaaaaaabbbbbbbbbbbbbbbbcccc", work));
+	CHECK_FALSE(work.exhausted);
+}
+
+TEST_CASE("Dictionary::set_hot_words", "[dictionary]")
+{
+	auto aff = istringstream("SFX S Y 1\n"
+	                         "SFX S 0 s .\n"
+	                         "COMPOUNDFLAG C\n"
+	                         "FORBIDDENWORD F\n");
+	auto dic = istringstream("6\ncat/S\ndog/SC\nhouse/C\nbad/F\nbad\n"
+	                         "the\n");
+	auto d = Dictionary::load_from_aff_dic(aff, dic);
+	auto words = vector<string>{"the",  "cats",     "dog",  "doghouse",
+	                            "bad",  "housedog", "cat",  "dogs",
+	                            "the",  "house",    "mice", "Cat"};
+	auto before = vector<bool>();
+	auto probes_before = vector<size_t>();
+	auto work = Spell_Work();
+	for (auto& w : words) {
+		before.push_back(d.spell(w, work));
+		probes_before.push_back(work.probes);
+	}
+	for (auto max_entries : {0, 1, 3, 100}) {
+		d.set_hot_words(words, max_entries);
+		for (size_t i = 0; i != words.size(); ++i) {
+			CHECK(d.spell(words[i], work) == before[i]);
+			CHECK(work.probes == probes_before[i]);
+		}
+	}
+	// analysis uses the real entries
+	auto out = vector<string>();
+	d.analyze("cats", out);
+	CHECK(out.size() == 1);
+}
+
+TEST_CASE("identify_language", "[dictionary]")
+{
+	auto aff_en = istringstream("SET UTF-8\nSFX S Y 1\nSFX S 0 s .\n");
+	auto dic_en = istringstream("8\nthe\ncat\ndog/S\nsees\na\nbird/S\n"
+	                            "and\nhouse/S\n");
+	auto en = Dictionary::load_from_aff_dic(aff_en, dic_en);
+	auto aff_de = istringstream("SET UTF-8\nSFX N Y 1\nSFX N 0 n .\n");
+	auto dic_de = istringstream("8\ndie\nkatze\nder\nhund\nsieht\nvogel\n"
+	                            "und\nstraße/N\n");
+	auto de = Dictionary::load_from_aff_dic(aff_de, dic_de);
+
+	auto text_en = string();
+	for (auto i = 0; i != 100; ++i)
+		text_en += "the dog sees a cat and birds, the houses. ";
+	auto text_de = string();
+	for (auto i = 0; i != 100; ++i)
+		text_de += "der hund sieht die katze und straßen; unbekannt ";
+
+	auto dics = vector<const Dictionary*>{&en, &de};
+	auto guess = identify_language(text_en, dics);
+	CHECK(guess.best == 0);
+	CHECK(guess.hit_rate(0) == 1.0);
+	CHECK(guess.hit_rate(1) == 0.0);
+
+	// without parallelism the chunks alternate and both stop early
+	auto sequential = Function_Executor([](auto) {}, 1);
+	guess = identify_language(text_en, dics, sequential);
+	CHECK(guess.best == 0);
+	CHECK(guess.checked[0] == 96);
+	CHECK(guess.checked[1] == 64);
+
+	guess = identify_language(text_de, dics, default_executor(), 70);
+	CHECK(guess.best == 1);
+	CHECK(guess.checked[1] <= 70);
+	CHECK(guess.hits[1] > 0);
+	CHECK(guess.hits[0] == 0);
+
+	guess = identify_language("123 !!", dics);
+	CHECK(guess.best == size_t(-1));
+	guess = identify_language("lorem ipsum dolor sit amet", dics);
+	CHECK(guess.best == size_t(-1));
+	CHECK(guess.checked[0] == 5);
+	CHECK(guess.hits[0] == 0);
+	guess = identify_language(text_en, {});
+	CHECK(guess.best == size_t(-1));
+}
+
+TEST_CASE("load_many", "[dictionary]")
+{
+	auto base = string("./load_many_test");
+	auto names = vector<string>();
+	for (auto i = 0; i != 5; ++i) {
+		auto path = base + to_string(i);
+		ofstream(path + ".aff") << "SET UTF-8\n";
+		ofstream(path + ".dic") << "1\nword" << i << '\n';
+		names.push_back(path);
+	}
+	ofstream(base + "_no_dic.aff") << "SET UTF-8\n";
+	names.push_back(base + "_no_dic");
+	names.push_back("no_such_dictionary_name");
+
+	auto res = load_many(names, Finder(), default_executor(), 2);
+	REQUIRE(res.size() == 7);
+	for (auto i = 0; i != 5; ++i) {
+		CHECK(res[i].name == names[i]);
+		CHECK(res[i].path == names[i]);
+		CHECK(res[i].error.empty());
+		REQUIRE(res[i].dictionary);
+		CHECK(res[i].dictionary->spell("word" + to_string(i)));
+		CHECK_FALSE(res[i].dictionary->spell("word"));
+	}
+	CHECK_FALSE(res[5].dictionary);
+	CHECK_FALSE(res[5].error.empty());
+	CHECK_FALSE(res[6].dictionary);
+	CHECK(res[6].path.empty());
+	CHECK(res[6].error.find("not found") != string::npos);
+
+	for (auto i = 0; i != 5; ++i) {
+		remove((names[i] + ".aff").c_str());
+		remove((names[i] + ".dic").c_str());
+	}
+	remove((base + "_no_dic.aff").c_str());
+}
+
+TEST_CASE("Dictionary::set_hot_words_cached", "[dictionary]")
+{
+	auto base = string("./hot_words_cache_test");
+	ofstream(base + ".aff") << "SET UTF-8\nSFX S Y 1\nSFX S 0 s .\n";
+	ofstream(base + ".dic") << "4\ncat/S\ndog/S\nžaba\nhouse\n";
+	auto cache = base + ".nuspell-cache";
+	remove(cache.c_str());
+	auto sample = vector<string>{"dogs", "žaba", "dog", "cats", "mice"};
+
+	auto d = Dictionary::load_from_path(base);
+	CHECK_FALSE(d.set_hot_words_cached(base, sample));
+	CHECK(ifstream(cache).good());
+	CHECK(d.spell("dogs"));
+	CHECK(d.spell("žaba"));
+
+	auto d2 = Dictionary::load_from_path(base);
+	CHECK(d2.set_hot_words_cached(base, sample));
+	CHECK(d2.spell("dogs"));
+	CHECK(d2.spell("žaba"));
+	CHECK_FALSE(d2.spell("mice"));
+
+	// a different sample or size invalidates the cache
+	CHECK_FALSE(d2.set_hot_words_cached(base, {"cat"}));
+	CHECK(d2.set_hot_words_cached(base, {"cat"}));
+	CHECK_FALSE(d2.set_hot_words_cached(base, {"cat"}, 10));
+
+	// so does a change of the dictionary, the loaded content counts
+	ofstream(base + ".dic") << "4\ncat/S\ndog/S\nžaba\nhorse\n";
+	CHECK(d2.set_hot_words_cached(base, {"cat"}, 10));
+	auto d3 = Dictionary::load_from_path(base);
+	CHECK_FALSE(d3.set_hot_words_cached(base, {"cat"}, 10));
+	CHECK(d3.spell("horse"));
+	CHECK_FALSE(d2.set_hot_words_cached(base, {"cat"}, 10));
+	CHECK_FALSE(d2.spell("horse"));
+	CHECK_FALSE(d3.set_hot_words_cached(base, {"cat"}, 10));
+
+	// a corrupt cache is rebuilt
+	ofstream(cache) << "NUSPCACH garbage";
+	CHECK_FALSE(d3.set_hot_words_cached(base, {"cat"}, 10));
+	CHECK(d3.set_hot_words_cached(base, {"cat"}, 10));
+
+	// threads that write the same cache do not corrupt it
+	remove(cache.c_str());
+	auto dics = vector<Dictionary>(4, d3);
+	auto threads = vector<thread>();
+	for (auto& d : dics)
+		threads.emplace_back(
+		    [&] { d.set_hot_words_cached(base, {"cat"}, 10); });
+	for (auto& t : threads)
+		t.join();
+	CHECK(d3.set_hot_words_cached(base, {"cat"}, 10));
+
+	remove((base + ".aff").c_str());
+	remove((base + ".dic").c_str());
+	remove(cache.c_str());
+}
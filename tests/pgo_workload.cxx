@@ -0,0 +1,134 @@
+/* Copyright 2019 Dimitrij Mijoski
+ *
+ * This file is part of Nuspell.
+ *
+ * Nuspell is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Nuspell is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Nuspell.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Training workload for profile-guided optimization, also a benchmark.
+// Usage: pgo_workload [-r rounds] dict_path_without_extension...
+//
+// For each dictionary it checks the words of the .dic, .good and .wrong
+// files, checks a generated corpus of misspellings of them, and asks for
+// suggestions for a part of the misspellings. Prints the total time.
+
+#include <nuspell/dictionary.hxx>
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+
+using namespace std;
+using namespace nuspell;
+
+auto read_words(const string& path, bool is_dic, vector<string>& out)
+{
+	auto in = ifstream(path);
+	auto line = string();
+	if (is_dic)
+		getline(in, line); // approximate count
+	while (getline(in, line)) {
+		auto end_word = line.find_first_of(is_dic ? "/\t " : "\t ");
+		line.erase(min(end_word, line.size()));
+		if (!line.empty())
+			out.push_back(line);
+	}
+}
+
+auto generate_misspellings(const vector<string>& words, vector<string>& out)
+{
+	for (size_t i = 0; i != words.size(); ++i) {
+		auto w = words[i];
+		if (w.size() < 3)
+			continue;
+		auto j = i % (w.size() - 1);
+		switch (i % 4) {
+		case 0:
+			swap(w[j], w[j + 1]);
+			break;
+		case 1:
+			w.erase(j, 1);
+			break;
+		case 2:
+			w.insert(j, 1, w[j]);
+			break;
+		case 3:
+			w[j] = 'a' + i % 26;
+			break;
+		}
+		out.push_back(w);
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	auto rounds = 3;
+	auto first_dict = 1;
+	if (argc > 2 && argv[1] == string("-r")) {
+		rounds = stoi(argv[2]);
+		first_dict = 3;
+	}
+	struct Job {
+		Dictionary dic;
+		vector<string> words;
+		vector<string> misspelled;
+	};
+	auto jobs = vector<Job>();
+	for (auto i = first_dict; i < argc; ++i) {
+		auto base = string(argv[i]);
+		auto job = Job();
+		try {
+			job.dic = Dictionary::load_from_path(base);
+		}
+		catch (const Dictionary_Loading_Error&) {
+			continue;
+		}
+		read_words(base + ".dic", true, job.words);
+		read_words(base + ".good", false, job.words);
+		read_words(base + ".wrong", false, job.misspelled);
+		generate_misspellings(job.words, job.misspelled);
+		jobs.push_back(move(job));
+	}
+	if (jobs.empty()) {
+		cerr << "No dictionaries loaded\n";
+		return 1;
+	}
+
+	auto num_spell = size_t(0);
+	auto num_suggest = size_t(0);
+	auto num_correct = size_t(0);
+	auto sugs = vector<string>();
+	auto t1 = chrono::steady_clock::now();
+	for (auto r = 0; r != rounds; ++r) {
+		for (auto& job : jobs) {
+			for (auto& w : job.words)
+				num_correct += job.dic.spell(w);
+			for (auto& w : job.misspelled)
+				num_correct += job.dic.spell(w);
+			num_spell += job.words.size() + job.misspelled.size();
+			// suggest is much slower, use a part
+			for (size_t i = 0; i < job.misspelled.size(); i += 4) {
+				job.dic.suggest(job.misspelled[i], sugs);
+				++num_suggest;
+			}
+		}
+	}
+	auto t2 = chrono::steady_clock::now();
+	auto ms = chrono::duration<double, milli>(t2 - t1).count();
+	cout << "dictionaries: " << jobs.size() << ", spell: " << num_spell
+	     << " (" << num_correct << " correct), suggest: " << num_suggest
+	     << '\n';
+	cout << "workload time: " << ms << " ms\n";
+	return 0;
+}
@@ -548,6 +548,40 @@ TEST_CASE("match_simple_regex", "[structures]")
 	CHECK_FALSE(match_simple_regex("qwerty"s, "abc?de*ff"s));
 }
 
+TEST_CASE("Compound_Rule_Table", "[structures]")
+{
+	auto flags = vector<Flag_Set>{u"A", u"B", u"AC", u"D", u"XYZ"};
+	auto parts = [&](initializer_list<size_t> ids) {
+		auto ret = vector<const Flag_Set*>();
+		for (auto i : ids)
+			ret.push_back(&flags[i]);
+		return ret;
+	};
+	// the first uses bit masks, the second has an operator char as a
+	// flag and the third has too many flags, they use plain matching
+	auto many = u16string(u"A*B?C");
+	for (char16_t c = 0x400; c != 0x440; ++c) {
+		many += c;
+		many += u'?';
+	}
+	for (auto rules : {vector<u16string>{u"A*B?C", u"DC*"},
+	                   vector<u16string>{u"A*B?C", u"DC*", u"?*D"},
+	                   vector<u16string>{many, u"DC*"}}) {
+		auto t = Compound_Rule_Table(rules);
+		CHECK(t.has_any_of_flags(flags[0]));
+		CHECK_FALSE(t.has_any_of_flags(flags[4]));
+		CHECK(t.match_any_rule(parts({0, 2})));
+		CHECK(t.match_any_rule(parts({0, 0, 1, 2})));
+		CHECK(t.match_any_rule(parts({2, 2, 1, 2})));
+		CHECK(t.match_any_rule(parts({3, 2, 2})));
+		CHECK(t.match_any_rule(parts({3})));
+		CHECK_FALSE(t.match_any_rule(parts({0, 1})));
+		CHECK_FALSE(t.match_any_rule(parts({1, 0})));
+		CHECK_FALSE(t.match_any_rule(parts({0, 1, 1, 2})));
+		CHECK_FALSE(t.match_any_rule(parts({0, 4})));
+	}
+}
+
 TEST_CASE("List_Strings", "[structures]")
 {
 	auto l = List_Strings();
@@ -654,3 +688,100 @@ TEST_CASE("Phonetic_Table", "[structures]")
 	CHECK(false == f5.replace(word));
 	CHECK(exp == word);
 }
+
+TEST_CASE("Hash_Multiset::shrink_to_fit", "[structures]")
+{
+	struct First {
+		auto& operator()(const pair<int, int>& p) const
+		{
+			return p.first;
+		}
+	};
+	auto set = Hash_Multiset<pair<int, int>, int, First>();
+	set.reserve(10000);
+	for (int i = 0; i != 100; ++i)
+		set.insert({i, 0});
+	set.insert({7, 1});
+	set.insert({7, 2});
+	auto old_buckets = set.bucket_count();
+	set.shrink_to_fit();
+	CHECK(set.bucket_count() < old_buckets);
+	CHECK(set.size() == 102);
+	for (int i = 0; i != 100; ++i) {
+		auto r = set.equal_range(i);
+		REQUIRE(r.first != r.second);
+		CHECK(r.first->first == i);
+	}
+	auto r = set.equal_range(7);
+	REQUIRE(r.second - r.first == 3);
+	CHECK(r.first[0].second == 0);
+	CHECK(r.first[1].second == 1);
+	CHECK(r.first[2].second == 2);
+}
+
+TEST_CASE("Hash_Multiset move insert", "[structures]")
+{
+	struct First {
+		auto& operator()(const pair<string, int>& p) const
+		{
+			return p.first;
+		}
+	};
+	auto set = Hash_Multiset<pair<string, int>, string, First>();
+	set.reserve(100);
+	auto buckets = set.bucket_count();
+	auto long_str = string(100, 'a');
+	auto value = pair<string, int>(long_str, 1);
+	auto data_ptr = value.first.data();
+	auto it = set.insert(move(value));
+	CHECK(it->first.data() == data_ptr);
+	for (int i = 0; i != 99; ++i)
+		set.emplace(to_string(i), i);
+	CHECK(set.bucket_count() == buckets);
+	CHECK(set.size() == 100);
+
+	// rehashing moves the values too
+	set.reserve(1000);
+	auto r = set.equal_range(long_str);
+	REQUIRE(r.first != r.second);
+	CHECK(r.first->first.data() == data_ptr);
+}
+
+TEST_CASE("Hot_Subset", "[structures]")
+{
+	struct First {
+		auto& operator()(const pair<string, int>& p) const
+		{
+			return p.first;
+		}
+	};
+	auto set = Hash_Multiset<pair<string, int>, string, First>();
+	for (int i = 0; i != 100; ++i) {
+		set.emplace(to_string(i), i);
+		if (i % 10 == 0)
+			set.emplace(to_string(i), -i);
+	}
+	auto hot = Hot_Subset<pair<string, int>, string, First>();
+	auto keys = vector<string>{"10", "5", "x", "10", "20", "30"};
+	hot.assign(set, keys, 5);
+	// "x" is missing, "10" is repeated, "30" does not fit
+	CHECK(hot.size() == 5);
+	auto h = hash<string>();
+	auto found = false;
+	auto r = hot.equal_range("10", h("10"), found);
+	CHECK(found);
+	CHECK(r.second - r.first == 2);
+	auto big = set.equal_range("10");
+	CHECK(equal(r.first, r.second, big.first, big.second));
+	r = hot.equal_range("20", h("20"), found);
+	CHECK(found);
+	CHECK(r.second - r.first == 2);
+	r = hot.equal_range("30", h("30"), found);
+	CHECK_FALSE(found);
+	CHECK(r.first == r.second);
+
+	hot.clear();
+	CHECK(hot.empty());
+	hot.equal_range("5", h("5"), found);
+	CHECK_FALSE(found);
+}
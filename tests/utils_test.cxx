@@ -16,10 +16,14 @@
  * along with Nuspell.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <nuspell/cpu_dispatch.hxx>
 #include <nuspell/utils.hxx>
 
 #include <boost/locale/utf8_codecvt.hpp>
 #include <catch2/catch.hpp>
+#include <cstdlib>
+#include <cstring>
+#include <random>
 
 using namespace std;
 using namespace nuspell;
@@ -154,6 +158,70 @@ TEST_CASE("wide_to_utf8", "[locale_utils]")
 	CHECK(exp == out);
 }
 
+TEST_CASE("utf8_to_wide", "[locale_utils]")
+{
+	auto out = wstring();
+	CHECK(utf8_to_wide("", out));
+	CHECK(out == L"");
+	auto ascii = string("The quick brown fox jumps over the lazy dog");
+	CHECK(utf8_to_wide(ascii, out));
+	CHECK(out == L"The quick brown fox jumps over the lazy dog");
+	CHECK(utf8_to_wide(ascii + ascii + "\u0436\U0001F600" + ascii, out));
+	CHECK(out == wstring(L"The quick brown fox jumps over the lazy dog"
+	                     L"The quick brown fox jumps over the lazy dog"
+	                     L"\u0436\U0001F600"
+	                     L"The quick brown fox jumps over the lazy dog"));
+	CHECK_FALSE(utf8_to_wide(ascii + "\xFF", out));
+	CHECK(out.size() == ascii.size() + 1);
+	CHECK(out.back() == L'\uFFFD');
+}
+
+TEST_CASE("CPU kernel variants", "[cpu_dispatch]")
+{
+	auto variants = get_cpu_kernel_variants();
+	REQUIRE(!variants.empty());
+	CHECK(variants[0]->name == string("generic"));
+	auto& selected = get_cpu_kernels();
+	CHECK(find(begin(variants), end(variants), &selected) != end(variants));
+	auto requested = getenv("NUSPELL_CPU");
+	auto is_supported = [&](const char* name) {
+		return any_of(begin(variants), end(variants), [&](auto v) {
+			return strcmp(v->name, name) == 0;
+		});
+	};
+	if (!requested)
+		CHECK(&selected == variants.back());
+	else if (is_supported(requested))
+		CHECK(selected.name == string(requested));
+	else
+		FAIL("NUSPELL_CPU variant not supported by this CPU: "
+		     << requested);
+
+	auto rng = minstd_rand(7);
+	auto in = string();
+	auto out = wstring();
+	for (auto v : variants) {
+		INFO(v->name);
+		for (size_t len = 0; len != 300; ++len) {
+			in.resize(len);
+			for (auto& c : in)
+				c = ' ' + rng() % 95;
+			auto expected_n = len;
+			if (len && rng() % 2) {
+				expected_n = rng() % len;
+				in[expected_n] = '\xC3';
+			}
+			// poison to see what is written
+			out.assign(len + 1, L'#');
+			auto n = v->widen_ascii(in.data(), len, out.data());
+			REQUIRE(n == expected_n);
+			for (size_t i = 0; i != n; ++i)
+				REQUIRE(out[i] == wchar_t(in[i]));
+			CHECK(out[len] == L'#');
+		}
+	}
+}
+
 TEST_CASE("classify_casing", "[locale_utils]")
 {
 	CHECK(Casing::SMALL == classify_casing(L""));
@@ -407,3 +475,17 @@ TEST_CASE("is_number", "[string_utils]")
 	CHECK_FALSE(is_number("-,1"s));
 	CHECK_FALSE(is_number(",1-"s));
 }
+
+TEST_CASE("hash_bytes", "[string_utils]")
+{
+	CHECK(hash_bytes({}, 5) == hash_bytes(""sv, 5));
+	CHECK(hash_bytes({}, 5) != hash_bytes({}, 6));
+	CHECK(hash_bytes("abc"sv, 0) == hash_bytes("abc"sv, 0));
+	CHECK(hash_bytes("abc"sv, 0) != hash_bytes("abd"sv, 0));
+	// the tail after the last 8 bytes and the length count
+	CHECK(hash_bytes("12345678a"sv, 0) != hash_bytes("12345678b"sv, 0));
+	CHECK(hash_bytes("12345678"sv, 0) != hash_bytes("12345678\0"sv, 0));
+	// chained hashes depend on the split
+	CHECK(hash_bytes("b"sv, hash_bytes("a"sv, 0)) !=
+	      hash_bytes("ab"sv, hash_bytes(""sv, 0)));
+}
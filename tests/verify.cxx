@@ -20,10 +20,13 @@
 #include <nuspell/finder.hxx>
 #include <nuspell/utils.hxx>
 
+#include <cerrno>
 #include <chrono>
+#include <cstring>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
+#include <memory>
 
 #include <boost/locale.hpp>
 
@@ -39,11 +42,153 @@
 #include <unistd.h>
 #endif
 
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+
 #include <hunspell/hunspell.hxx>
 
 using namespace std;
 using namespace nuspell;
 
+/**
+ * @brief Hardware performance counters of the calling thread.
+ *
+ * Reads Linux perf_event_open() counters between start() and stop(). The
+ * counts accumulate over all start/stop intervals. Counters that can not be
+ * opened, e.g. due to perf_event_paranoid, missing hardware support or a
+ * virtual machine, are skipped and the rest still work. On other systems
+ * none are available.
+ */
+class Perf_Counters {
+      public:
+	struct Counter {
+		const char* name;
+		uint32_t type;
+		uint64_t config;
+		int fd;
+	};
+
+      private:
+	vector<Counter> counters;
+	int leader = -1;
+	int open_error = 0;
+
+      public:
+	Perf_Counters();
+	~Perf_Counters();
+	Perf_Counters(const Perf_Counters&) = delete;
+	auto operator=(const Perf_Counters&) = delete;
+	auto available() const { return leader != -1; }
+	auto start() -> void;
+	auto stop() -> void;
+	auto report(ostream& out, const string& title, size_t num_ops) const
+	    -> void;
+};
+
+#ifdef __linux__
+Perf_Counters::Perf_Counters()
+{
+	auto cache = [](uint64_t id, uint64_t op, uint64_t result) {
+		return id | (op << 8) | (result << 16);
+	};
+	counters = {
+	    {"cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, -1},
+	    {"instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS,
+	     -1},
+	    {"L1d-misses", PERF_TYPE_HW_CACHE,
+	     cache(PERF_COUNT_HW_CACHE_L1D, PERF_COUNT_HW_CACHE_OP_READ,
+	           PERF_COUNT_HW_CACHE_RESULT_MISS),
+	     -1},
+	    {"LLC-misses", PERF_TYPE_HW_CACHE,
+	     cache(PERF_COUNT_HW_CACHE_LL, PERF_COUNT_HW_CACHE_OP_READ,
+	           PERF_COUNT_HW_CACHE_RESULT_MISS),
+	     -1},
+	    {"branch-misses", PERF_TYPE_HARDWARE,
+	     PERF_COUNT_HW_BRANCH_MISSES, -1},
+	    {"dTLB-misses", PERF_TYPE_HW_CACHE,
+	     cache(PERF_COUNT_HW_CACHE_DTLB, PERF_COUNT_HW_CACHE_OP_READ,
+	           PERF_COUNT_HW_CACHE_RESULT_MISS),
+	     -1}};
+	for (auto& c : counters) {
+		auto attr = perf_event_attr();
+		attr.size = sizeof(attr);
+		attr.type = c.type;
+		attr.config = c.config;
+		attr.disabled = leader == -1;
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+		attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED |
+		                   PERF_FORMAT_TOTAL_TIME_RUNNING;
+		c.fd = syscall(SYS_perf_event_open, &attr, 0, -1, leader, 0);
+		if (c.fd == -1 && open_error == 0)
+			open_error = errno;
+		if (c.fd != -1 && leader == -1)
+			leader = c.fd;
+	}
+}
+
+Perf_Counters::~Perf_Counters()
+{
+	for (auto& c : counters)
+		if (c.fd != -1)
+			close(c.fd);
+}
+
+auto Perf_Counters::start() -> void
+{
+	if (leader != -1)
+		ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+}
+
+auto Perf_Counters::stop() -> void
+{
+	if (leader != -1)
+		ioctl(leader, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+}
+
+auto Perf_Counters::report(ostream& out, const string& title,
+                           size_t num_ops) const -> void
+{
+	out << "Counters " << title << ", per operation of " << num_ops
+	    << '\n';
+	if (leader == -1) {
+		out << "  not available: " << strerror(open_error)
+		    << ", see /proc/sys/kernel/perf_event_paranoid\n";
+		return;
+	}
+	for (auto& c : counters) {
+		out << "  " << left << setw(18) << c.name << right;
+		uint64_t val[3]; // value, time enabled, time running
+		auto ok = c.fd != -1 && read(c.fd, val, sizeof(val)) == sizeof(val);
+		if (!ok) {
+			out << "not supported\n";
+			continue;
+		}
+		if (val[2] == 0) {
+			out << "not counted\n";
+			continue;
+		}
+		// scale up if the counters were multiplexed
+		auto v = double(val[0]) * val[1] / val[2];
+		out << fixed << setprecision(1) << v / max<size_t>(num_ops, 1)
+		    << defaultfloat << setprecision(6) << '\n';
+	}
+}
+#else
+Perf_Counters::Perf_Counters() {}
+Perf_Counters::~Perf_Counters() {}
+auto Perf_Counters::start() -> void {}
+auto Perf_Counters::stop() -> void {}
+auto Perf_Counters::report(ostream& out, const string& title, size_t) const
+    -> void
+{
+	out << "Counters " << title << "\n  not available on this system\n";
+}
+#endif
+
 enum Mode {
 	DEFAULT_MODE /**< verification test */,
 	HELP_MODE /**< printing help information */,
@@ -57,6 +202,8 @@ struct Args_t {
 	string dictionary;
 	string encoding;
 	bool print_false = false;
+	bool counters = false;
+	bool suggest = false;
 	vector<string> other_dicts;
 	vector<string> files;
 
@@ -75,7 +222,7 @@ auto Args_t::parse_args(int argc, char* argv[]) -> void
 	int c;
 	// The program can run in various modes depending on the
 	// command line options. mode is FSM state, this while loop is FSM.
-	const char* shortopts = ":d:i:Fhv";
+	const char* shortopts = ":d:i:Fcshv";
 	const struct option longopts[] = {
 	    {"version", 0, nullptr, 'v'},
 	    {"help", 0, nullptr, 'h'},
@@ -101,6 +248,14 @@ auto Args_t::parse_args(int argc, char* argv[]) -> void
 		case 'F':
 			print_false = true;
 
+			break;
+		case 'c':
+			counters = true;
+
+			break;
+		case 's':
+			suggest = true;
+
 			break;
 		case 'h':
 			if (mode == DEFAULT_MODE)
@@ -145,7 +300,7 @@ auto print_help(const string& program_name) -> void
 	auto& o = cout;
 	o << "Usage:\n"
 	     "\n";
-	o << p << " [-d dict_NAME] [-i enc] [file_name]...\n";
+	o << p << " [-c] [-s] [-d dict_NAME] [-i enc] [file_name]...\n";
 	o << p << " -h|--help|-v|--version\n";
 	o << "\n"
 	     "Verification testing spell check of each FILE. Without FILE, "
@@ -158,6 +313,10 @@ auto print_help(const string& program_name) -> void
 	     "                currently supported\n"
 	     "  -i enc        input encoding, default is active locale\n"
 	     "  -F            print false negative and false positive words\n"
+	     "  -c            report hardware performance counters of Nuspell\n"
+	     "                for loading, spell and suggest, Linux only\n"
+	     "  -s            also measure Nuspell suggest on the words it\n"
+	     "                finds misspelled\n"
 	     "  -h, --help    print this help and exit\n"
 	     "  -v, --version print version number and exit\n"
 	     "\n";
@@ -176,6 +335,9 @@ auto print_help(const string& program_name) -> void
 	     "  Duration Nuspell    [0,1,..] nanoseconds\n"
 	     "  Duration Hunspell   [0,1,..] nanoseconds\n"
 	     "  Speedup Rate        [0.00,..,9.99]\n"
+	     "With -s also the number of suggest calls and their duration.\n"
+	     "With -c the counters are printed per operation, i.e. per loaded\n"
+	     "dictionary, per checked word and per suggest call.\n"
 	     "All durations are highly machine and platform dependent.\n"
 	     "Even on the same machine it varies a lot in the second decimal!\n"
 	     "If speedup is 1.60, Nuspell is 1.60 times faster as Hunspell.\n"
@@ -221,7 +383,8 @@ auto print_version() -> void
 }
 
 auto normal_loop(istream& in, ostream& out, Dictionary& dic, Hunspell& hun,
-                 locale& hloc, bool print_false = false)
+                 locale& hloc, bool print_false = false, bool counters = false,
+                 bool suggest = false)
 {
 	auto word = string();
 	auto wide_word = wstring();
@@ -236,18 +399,43 @@ auto normal_loop(istream& in, ostream& out, Dictionary& dic, Hunspell& hun,
 	// store cpu time for Hunspell and Nuspell
 	auto duration_hun = chrono::high_resolution_clock::duration();
 	auto duration_nu = duration_hun;
+	auto duration_sug = duration_hun;
+	auto total_sug = size_t(0);
+	auto sug = vector<string>();
+	auto spell_pc = unique_ptr<Perf_Counters>();
+	auto sug_pc = unique_ptr<Perf_Counters>();
+	if (counters) {
+		spell_pc = make_unique<Perf_Counters>();
+		if (suggest)
+			sug_pc = make_unique<Perf_Counters>();
+	}
 	auto in_loc = in.getloc();
 	// need to take entine line here, not `in >> word`
 	while (getline(in, word)) {
+		if (spell_pc)
+			spell_pc->start();
 		auto tick_a = chrono::high_resolution_clock::now();
 		auto res_nu = dic.spell(word);
 		auto tick_b = chrono::high_resolution_clock::now();
+		if (spell_pc)
+			spell_pc->stop();
 		to_wide(word, in_loc, wide_word);
 		to_narrow(wide_word, narrow_word, hloc);
 		auto res_hun = hun.spell(narrow_word);
 		auto tick_c = chrono::high_resolution_clock::now();
 		duration_nu += tick_b - tick_a;
 		duration_hun += tick_c - tick_b;
+		if (suggest && !res_nu) {
+			if (sug_pc)
+				sug_pc->start();
+			auto tick_d = chrono::high_resolution_clock::now();
+			dic.suggest(word, sug);
+			auto tick_e = chrono::high_resolution_clock::now();
+			if (sug_pc)
+				sug_pc->stop();
+			duration_sug += tick_e - tick_d;
+			++total_sug;
+		}
 		if (res_hun) {
 			if (res_nu) {
 				++true_pos;
@@ -298,6 +486,14 @@ auto normal_loop(istream& in, ostream& out, Dictionary& dic, Hunspell& hun,
 	out << "Duration Nuspell    " << duration_nu.count() << '\n';
 	out << "Duration Hunspell   " << duration_hun.count() << '\n';
 	out << "Speedup Rate        " << speedup << '\n';
+	if (suggest) {
+		out << "Total Suggest       " << total_sug << '\n';
+		out << "Duration Suggest    " << duration_sug.count() << '\n';
+	}
+	if (spell_pc)
+		spell_pc->report(out, "Nuspell spell", total);
+	if (sug_pc)
+		sug_pc->report(out, "Nuspell suggest", total_sug);
 
 	// summarey for easy reporting
 	out << fixed << total << ' ' << true_pos << ' ' << true_neg << ' '
@@ -388,7 +584,16 @@ int main(int argc, char* argv[])
 	clog << "INFO: Pointed dictionary " << filename << ".{dic,aff}\n";
 	auto dic = Dictionary();
 	try {
+		auto load_pc = unique_ptr<Perf_Counters>();
+		if (args.counters) {
+			load_pc = make_unique<Perf_Counters>();
+			load_pc->start();
+		}
 		dic = Dictionary::load_from_path(filename);
+		if (load_pc) {
+			load_pc->stop();
+			load_pc->report(cout, "Nuspell load", 1);
+		}
 	}
 	catch (const Dictionary_Loading_Error& e) {
 		cerr << e.what() << '\n';
@@ -403,7 +608,8 @@ int main(int argc, char* argv[])
 	    "en_US." + Encoding(hun.get_dict_encoding()).value_or_default());
 
 	if (args.files.empty()) {
-		normal_loop(cin, cout, dic, hun, hun_loc, args.print_false);
+		normal_loop(cin, cout, dic, hun, hun_loc, args.print_false,
+		            args.counters, args.suggest);
 	}
 	else {
 		for (auto& file_name : args.files) {
@@ -414,7 +620,8 @@ int main(int argc, char* argv[])
 			}
 			in.imbue(cin.getloc());
 			normal_loop(in, cout, dic, hun, hun_loc,
-			            args.print_false);
+			            args.print_false, args.counters,
+			            args.suggest);
 		}
 	}
 	return 0;